@@ -41,14 +41,16 @@ public:
         m_flags = NodeFlags::OwnerDraw;
 
         pSum = AddOutput("Sumf", .0f, ParameterAttributes(ParameterUI::Knob, 0.0f, 1.0f));
-        pSum->GetAttributes().flags |= ParameterFlags::ReadOnly;
+        pSum->ModifyAttributes([](ParameterAttributes& attrib) { attrib.flags |= ParameterFlags::ReadOnly; });
 
         pValue2 = AddInput("0-1000f", 5.0f, ParameterAttributes(ParameterUI::Knob, 0.01f, 1000.0f));
-        pValue2->GetAttributes().taper = 2;
+        pValue2->ModifyAttributes([](ParameterAttributes& attrib) { attrib.taper = 2; });
 
         pValue10 = AddInput("2048-4800", (int64_t)48000, ParameterAttributes(ParameterUI::Knob, (int64_t)2048, (int64_t)48000));
-        pValue10->GetAttributes().taper = 4.6f;
-        pValue10->GetAttributes().postFix = "Hz";
+        pValue10->ModifyAttributes([](ParameterAttributes& attrib) {
+            attrib.taper = 4.6f;
+            attrib.postFix = "Hz";
+        });
 
         pValue3 = AddInput("-1->+1f", .001f, ParameterAttributes(ParameterUI::Knob, -1.0f, 1.0f));
 
@@ -57,13 +59,13 @@ public:
         pValue5 = AddInput("Small", (int64_t)-10, ParameterAttributes(ParameterUI::Knob, (int64_t)-10, (int64_t)10));
 
         pValue6 = AddInput("-10->10is", (int64_t)-10, ParameterAttributes(ParameterUI::Knob, (int64_t)-10, (int64_t)10));
-        pValue6->GetAttributes().step = (int64_t)4;
+        pValue6->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = (int64_t)4; });
 
         pValue7 = AddInput("0->1000ie", (int64_t)0, ParameterAttributes(ParameterUI::Knob, (int64_t)0, (int64_t)1000));
-        pValue7->GetAttributes().postFix = "dB";
+        pValue7->ModifyAttributes([](ParameterAttributes& attrib) { attrib.postFix = "dB"; });
 
         pValue8 = AddInput("0->1%", 0.0f, ParameterAttributes(ParameterUI::Knob, (float)0.0f, (float)1.0f));
-        pValue8->GetAttributes().displayType = ParameterDisplayType::Percentage;
+        pValue8->ModifyAttributes([](ParameterAttributes& attrib) { attrib.displayType = ParameterDisplayType::Percentage; });
 
         pSlider = AddInput("Variable A", 0.5f);
         pButton = AddInput("Button", (int64_t)0);
@@ -86,7 +88,7 @@ public:
         buttonAttrib.labels = { "A", "B", "C" };
         pButton->SetAttributes(buttonAttrib);
 
-        auto pDecorator = AddDecorator(new NodeDecorator(DecoratorType::Label, "Label"));
+        auto pDecorator = AddDecorator(DecoratorType::Label, "Label");
         pDecorator->gridLocation = NRectf(6, 1, 1, 1);
 
         const NVec2f KnobWidgetSize(70.0f, 90.0f);
@@ -152,23 +154,25 @@ public:
         pSum = AddOutput("Sumf", .5f, ParameterAttributes(ParameterUI::Knob, 0.0f, 1.0f));
 
         pValue1 = AddInput("0-1000f", 5.0f, ParameterAttributes(ParameterUI::Knob, 0.01f, 1000.0f));
-        pValue1->GetAttributes().taper = 2;
+        pValue1->ModifyAttributes([](ParameterAttributes& attrib) { attrib.taper = 2; });
 
         pValue2 = AddInput("Foobar1", 0.5f, ParameterAttributes(ParameterUI::Slider, 0.0f, 1.0f));
-        pValue2->GetAttributes().step = 0.25f;
+        pValue2->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = 0.25f; });
 
         pValue3 = AddInput("Amp", 0.5f, ParameterAttributes(ParameterUI::Slider, 0.0f, 1.0f));
-        pValue3->GetAttributes().step = 0.01f;
-        pValue3->GetAttributes().taper = 4;
+        pValue3->ModifyAttributes([](ParameterAttributes& attrib) {
+            attrib.step = 0.01f;
+            attrib.taper = 4;
+        });
 
         pValue4 = AddInput("Noise", 0.5f, ParameterAttributes(ParameterUI::Slider, 0.0f, 1.0f));
-        pValue4->GetAttributes().step = 0.25f;
+        pValue4->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = 0.25f; });
 
         pValue5 = AddInput("Slider", 0.5f, ParameterAttributes(ParameterUI::Slider, 0.0f, 1.0f));
-        pValue5->GetAttributes().step = 0.25f;
+        pValue5->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = 0.25f; });
         //ParameterAttributes sliderAttrib(ParameterUI::Slider, 0.0f, 1.0f);
         pValue6 = AddInput("Slider", 0.5f, ParameterAttributes(ParameterUI::Slider, 0.0f, 1.0f));
-        pValue6->GetAttributes().step = 0.25f;
+        pValue6->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = 0.25f; });
         //sliderAttrib.step = 0.25f;
         //sliderAttrib.thumb = 0.25f;
         //pValue2->SetAttributes(sliderAttrib);
@@ -216,7 +220,7 @@ public:
         m_flags |= NodeFlags::OwnerDraw;
 
         pNumber = AddInput("Number", 1.0f, ParameterAttributes(ParameterUI::Slider, -1.0f, 1.0f));
-        pNumber->GetAttributes().step = 0.01f;
+        pNumber->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = 0.01f; });
         
         pOutput = AddOutputFlow("Output", new FlowData(FlowType_Data, ParameterType::Float));
 
@@ -245,13 +249,13 @@ public:
     explicit SinNode(Graph& graph)
         : Node(graph, "Sin")
     {
-        m_flags |= NodeFlags::OwnerDraw;
+        m_flags |= NodeFlags::OwnerDraw | NodeFlags::AlwaysCompute;
 
         pAmp = AddInput("Amp", 1.0f, ParameterAttributes(ParameterUI::Slider, 0.0f, 1.0f));
-        pAmp->GetAttributes().step = 0.01f;
+        pAmp->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = 0.01f; });
         
         pFreq = AddInput("Freq", 1.0f, ParameterAttributes(ParameterUI::Slider, 1.0f, 10.0f));
-        pFreq->GetAttributes().step = 0.1f;
+        pFreq->ModifyAttributes([](ParameterAttributes& attrib) { attrib.step = 0.1f; });
         
         pOutput = AddOutputFlow("Sin", new FlowData(FlowType_Data, ParameterType::Float));
 
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace NodeGraph
+{
+
+// Per graph allocator for nodes, pins and decorators.
+// Small objects are carved from large blocks in the order they are made, so a node and
+// the pins it adds in its constructor sit next to each other. Freed memory goes on a free
+// list for its size class; Reset drops everything at once.
+// Big or over aligned objects get an allocation of their own, which the arena still tracks.
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(size_t size, size_t align = alignof(std::max_align_t));
+    void Free(void* pMemory);
+
+    // Forget every allocation and release all but the first block.
+    // Only call this once everything allocated has been destroyed.
+    void Reset();
+
+    // True if the memory is inside anything this arena allocated, in a block or on its own
+    bool Owns(const void* pMemory) const;
+
+    template <typename T, typename... Args>
+    T* New(Args&&... args)
+    {
+        auto pMemory = Allocate(sizeof(T), alignof(T));
+        try
+        {
+            return new (pMemory) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            Free(pMemory);
+            throw;
+        }
+    }
+
+    // Works through a base pointer, as long as the destructor is virtual
+    template <typename T>
+    void Delete(T* pObject)
+    {
+        if (!pObject)
+        {
+            return;
+        }
+
+        void* pStart = pObject;
+        if constexpr (std::is_polymorphic_v<T>)
+        {
+            pStart = dynamic_cast<void*>(pObject);
+        }
+
+        pObject->~T();
+        Free(pStart);
+    }
+
+    size_t GetNumBlocks() const
+    {
+        return m_blocks.size();
+    }
+
+private:
+    // Sits just before every allocation
+    struct Header
+    {
+        uint32_t sizeClass;
+        uint32_t offset; // Back to the start of a large allocation
+        uint64_t magic;
+    };
+
+    static const size_t Granularity = 16;
+    static const size_t MaxSmallSize = 4096;
+    static const uint32_t LargeClass = 0xFFFFFFFF;
+
+    void* AllocateLarge(size_t size, size_t align);
+    void FreeLarge();
+    void NewBlock();
+
+    struct FreeNode
+    {
+        FreeNode* pNext;
+    };
+
+    size_t m_blockSize;
+    std::vector<uint8_t*> m_blocks;
+    uint8_t* m_pCurrent = nullptr;
+    uint8_t* m_pEnd = nullptr;
+    std::vector<FreeNode*> m_freeLists;
+    std::map<uint8_t*, size_t> m_large; // Start of each large object to its size
+};
+
+} // namespace NodeGraph
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace NodeGraph
+{
+
+// A point on an automation timeline. The curve shapes the segment from this point to the next:
+// 0 is a straight line, positive bends it late and negative early.
+// Two points on the same tick make a step.
+struct AutomationPoint
+{
+    int64_t tick = 0;
+    double value = 0.0;
+    float curve = 0.0f;
+};
+
+// Breakpoints for a parameter, in tick order, with room for a fixed number of them.
+// Storage is allocated once up front, so points can be streamed in at block rate without allocating.
+// Reading is done through a cursor owned by the reader, so one timeline can drive many parameters;
+// the cursor only walks forward while the ticks do, which keeps the cost per tick constant.
+class AutomationTimeline
+{
+public:
+    explicit AutomationTimeline(uint32_t capacity);
+
+    // Insert in tick order, after any point already on the same tick; false when full
+    bool Add(int64_t tick, double value, float curve = 0.0f);
+
+    // Drop every point before tick, keeping the one the segment at tick starts from.
+    // Lets a recording stream through a small timeline; reset readers' cursors afterwards.
+    void Trim(int64_t tick);
+    void Clear();
+
+    // The value at tick; holds the first value before the start and the last after the end
+    double ValueAt(int64_t tick, uint32_t& cursor) const;
+
+    // The value at each of count ticks from tick
+    void Render(int64_t tick, float* pOut, uint32_t count, uint32_t& cursor) const;
+
+    const std::vector<AutomationPoint>& GetPoints() const
+    {
+        return m_points;
+    }
+
+    uint32_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+    bool Empty() const
+    {
+        return m_points.empty();
+    }
+
+private:
+    // Move the cursor to the last point at or before tick
+    void Seek(int64_t tick, uint32_t& cursor) const;
+    double SegmentValue(uint32_t index, int64_t tick) const;
+
+    std::vector<AutomationPoint> m_points;
+    uint32_t m_capacity = 0;
+};
+
+} // namespace NodeGraph
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace NodeGraph
+{
+
+// A growable bitset for marking dense indices (node indices, plan steps).
+// Growing never loses bits; clearing keeps the memory.
+class DenseBitset
+{
+public:
+    void Resize(size_t numBits)
+    {
+        auto numWords = (numBits + 63) / 64;
+        if (numWords > m_words.size())
+        {
+            m_words.resize(numWords, 0);
+        }
+    }
+
+    size_t Capacity() const
+    {
+        return m_words.size() * 64;
+    }
+
+    void ClearAll()
+    {
+        for (auto& word : m_words)
+        {
+            word = 0;
+        }
+    }
+
+    bool Test(size_t bit) const
+    {
+        auto word = bit / 64;
+        return word < m_words.size() && (m_words[word] & (uint64_t(1) << (bit % 64))) != 0;
+    }
+
+    // Grows to fit the bit if necessary
+    void Set(size_t bit)
+    {
+        Resize(bit + 1);
+        m_words[bit / 64] |= (uint64_t(1) << (bit % 64));
+    }
+
+    void Reset(size_t bit)
+    {
+        auto word = bit / 64;
+        if (word < m_words.size())
+        {
+            m_words[word] &= ~(uint64_t(1) << (bit % 64));
+        }
+    }
+
+    // Set the bit, returning true if it was already set
+    bool TestAndSet(size_t bit)
+    {
+        Resize(bit + 1);
+        auto& word = m_words[bit / 64];
+        auto mask = uint64_t(1) << (bit % 64);
+        auto wasSet = (word & mask) != 0;
+        word |= mask;
+        return wasSet;
+    }
+
+    // Call fn(index) for each set bit, in index order
+    template <typename Fn>
+    void ForEach(Fn&& fn) const
+    {
+        for (size_t word = 0; word < m_words.size(); word++)
+        {
+            auto bits = m_words[word];
+            while (bits != 0)
+            {
+                fn(word * 64 + LowestBit(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    static uint32_t LowestBit(uint64_t bits)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return uint32_t(index);
+#else
+        return uint32_t(__builtin_ctzll(bits));
+#endif
+    }
+
+    std::vector<uint64_t> m_words;
+};
+
+} // namespace NodeGraph
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+namespace NodeGraph
+{
+
+class Graph;
+class Node;
+
+// A node in the plan, with the ranges of plan indices that feed and read its flow pins
+struct PlanStep
+{
+    Node* pNode = nullptr;
+    uint32_t firstSource = 0;
+    uint32_t numSources = 0;
+    uint32_t firstTarget = 0;
+    uint32_t numTargets = 0;
+
+    // Length of the longest chain of sources above this step
+    uint32_t level = 0;
+};
+
+// A flat, topologically sorted list of the nodes needed to compute a set of output nodes.
+// Sources always appear before the nodes that read them, so the plan can be walked linearly.
+// The graph rebuilds it after a modification; walking it allocates nothing.
+class ExecutionPlan
+{
+public:
+    void Build(Graph& graph, const std::set<Node*>& outNodes);
+    void Clear();
+
+    // True if this plan was built for exactly these output nodes
+    bool Matches(const std::set<Node*>& outNodes) const;
+
+    const std::vector<PlanStep>& GetSteps() const
+    {
+        return m_steps;
+    }
+
+    // Plan indices of the steps feeding the flow inputs of this step
+    const uint32_t* GetSources(const PlanStep& step) const
+    {
+        return m_sources.data() + step.firstSource;
+    }
+
+    // Plan indices of the steps reading the flow outputs of this step
+    const uint32_t* GetTargets(const PlanStep& step) const
+    {
+        return m_targets.data() + step.firstTarget;
+    }
+
+    // Steps that only depend on earlier levels, so they can all be computed at once
+    uint32_t GetNumLevels() const
+    {
+        return m_levelOffsets.empty() ? 0 : uint32_t(m_levelOffsets.size() - 1);
+    }
+
+    // Plan indices of the steps in a level
+    const uint32_t* GetLevelBegin(uint32_t level) const
+    {
+        return m_levelSteps.data() + m_levelOffsets[level];
+    }
+    const uint32_t* GetLevelEnd(uint32_t level) const
+    {
+        return m_levelSteps.data() + m_levelOffsets[level + 1];
+    }
+
+    // Plan indices of the steps whose flow outputs nobody reads once this step is done, when
+    // the plan is walked in order. Outputs of the roots, or read by nodes outside the plan, are never listed.
+    const uint32_t* GetReleasesBegin(uint32_t stepIndex) const
+    {
+        return m_releaseSteps.data() + m_releaseOffsets[stepIndex];
+    }
+    const uint32_t* GetReleasesEnd(uint32_t stepIndex) const
+    {
+        return m_releaseSteps.data() + m_releaseOffsets[stepIndex + 1];
+    }
+
+private:
+    void BuildTargets();
+    void BuildLevels();
+    void BuildReleases(const std::vector<uint32_t>& planIndex);
+
+    std::vector<Node*> m_roots;
+    std::vector<PlanStep> m_steps;
+    std::vector<uint32_t> m_sources;
+    std::vector<uint32_t> m_targets;
+    std::vector<uint32_t> m_levelSteps;
+    std::vector<uint32_t> m_levelOffsets;
+    std::vector<uint32_t> m_releaseSteps;
+    std::vector<uint32_t> m_releaseOffsets;
+};
+
+} // namespace NodeGraph
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+#include "nodegraph/model/parameter.h"
+
+namespace NodeGraph
+{
+
+// Converts count samples of one parameter type to another; the buffers may be unaligned
+using ConvertKernel = void (*)(const void* pSource, void* pDest, uint32_t count);
+
+// The kernel for a pair of sample types (Float, Double, Int64 or Bool), or null if there isn't one.
+// Picked once at startup for the best instruction set the CPU has.
+ConvertKernel GetConvertKernel(ParameterType from, ParameterType to);
+
+// Returns false if the types can't be converted
+bool ConvertSamples(ParameterType from, const void* pSource, ParameterType to, void* pDest, uint32_t count);
+
+// "AVX2", "SSE2" or "Scalar"
+const char* GetConvertKernelSet();
+
+// pDest[i] = start + step * i; computed per sample, so long ramps don't drift
+void FillRamp(float* pDest, uint32_t count, float start, float step);
+
+} // namespace NodeGraph
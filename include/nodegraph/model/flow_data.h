@@ -1,6 +1,18 @@
 #pragma once
+#include "nodegraph/model/flow_convert.h"
 #include "nodegraph/model/parameter.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <map>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gsl-lite/gsl-lite.hpp>
+#include <mutils/thread/thread_utils.h>
 
 namespace NodeGraph {
 
@@ -10,55 +22,469 @@ enum
     None = 0,
 };
 }
+// A block of samples for one channel.
+// The storage starts on an Alignment boundary and is padded out to a multiple of Alignment, with
+// the padding kept zeroed, so kernels can use aligned full width loads and read past the last sample.
+// Copies share the storage; the non-const accessors make a private copy first if it is shared,
+// so passing a channel through costs nothing until someone writes to it.
+// The storage carries a generation that every non-const access moves on, so anything derived
+// from the samples can tell whether it is still current.
 class Channel
 {
 public:
+    static constexpr uint32_t Alignment = 64;
+
     Channel(uint32_t size = 0)
-        : data(size, 0)
     {
+        SetSizeInBytes(size);
+    }
+
+    Channel(const Channel& rhs)
+        : flags(rhs.flags)
+        , m_pData(rhs.m_pData)
+        , m_size(rhs.m_size)
+        , m_capacity(rhs.m_capacity)
+    {
+        if (m_pData)
+        {
+            GetHeader(m_pData).refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Channel(Channel&& rhs) noexcept
+    {
+        Swap(rhs);
+    }
+
+    Channel& operator=(const Channel& rhs)
+    {
+        Channel copy(rhs);
+        Swap(copy);
+        return *this;
+    }
+
+    Channel& operator=(Channel&& rhs) noexcept
+    {
+        Swap(rhs);
+        return *this;
+    }
+
+    ~Channel()
+    {
+        Free(m_pData);
     }
 
     template <typename T>
-    T* Ptr(uint32_t index = 0) const
+    const T* Ptr(uint32_t index = 0) const
     {
-        if (data.empty())
+        if (m_size == 0)
+        {
+            return (const T*)nullptr;
+        }
+        return (const T*)&m_pData[sizeof(T) * index]; 
+    }
+
+    template <typename T>
+    T* Ptr(uint32_t index = 0)
+    {
+        if (m_size == 0)
         {
             return (T*)nullptr;
         }
-        return (T*)&data[sizeof(T) * index]; 
+        BeginWrite();
+        return (T*)&m_pData[sizeof(T) * index]; 
     }
     
     template <typename T>
-    T& Val(uint32_t index = 0) const
+    const T& Val(uint32_t index = 0) const
+    {
+        assert(m_size > (sizeof(T) * index));
+        return *(const T*)&m_pData[sizeof(T) * index]; 
+    }
+
+    template <typename T>
+    T& Val(uint32_t index = 0)
+    {
+        assert(m_size > (sizeof(T) * index));
+        BeginWrite();
+        return *(T*)&m_pData[sizeof(T) * index]; 
+    }
+
+    // The samples as T; the span covers whole samples only, not the padding
+    template <typename T>
+    gsl::span<T> Span()
+    {
+        BeginWrite();
+        return gsl::span<T>((T*)m_pData, m_size / sizeof(T));
+    }
+
+    template <typename T>
+    gsl::span<const T> Span() const
     {
-        assert(data.size() > (sizeof(T) * index));
-        return (T&)data[sizeof(T) * index]; 
+        return gsl::span<const T>((const T*)m_pData, m_size / sizeof(T));
     }
 
     uint32_t ByteSize() const
     {
-        return uint32_t(data.size());
+        return m_size;
+    }
+
+    // Size including the zeroed padding; always a multiple of Alignment
+    uint32_t PaddedByteSize() const
+    {
+        return m_capacity;
     }
 
+    // True if another channel has the same storage
+    bool IsShared() const
+    {
+        return m_pData && GetHeader(m_pData).refCount.load(std::memory_order_acquire) > 1;
+    }
+
+    // Changes whenever the samples might have; never repeats, even across allocations.
+    // 0 if there is no storage.
+    uint64_t GetGeneration() const
+    {
+        return m_pData ? GetHeader(m_pData).generation : 0;
+    }
+
+    // New bytes are zero, as with std::vector::resize
     void SetSizeInBytes(uint32_t size)
     {
-        data.resize(size, 0);
+        if (size == m_size)
+        {
+            return;
+        }
+
+        if (size > m_capacity || IsShared())
+        {
+            Reallocate(size);
+        }
+        else if (size < m_size)
+        {
+            // Keep the padding zeroed
+            memset(m_pData + size, 0, m_size - size);
+        }
+        m_size = size;
+        if (m_pData)
+        {
+            GetHeader(m_pData).generation++;
+        }
     }
 
     void SetFrom(const std::vector<uint8_t>& rhs)
     {
-        data = rhs; 
+        SetFrom(rhs.data(), uint32_t(rhs.size()));
     }
 
-    const std::vector<uint8_t>& GetVector() const
+    void SetFrom(const uint8_t* pData, uint32_t size)
     {
-        return data; 
+        SetSizeInBytes(size);
+        if (size != 0)
+        {
+            BeginWrite();
+            memcpy(m_pData, pData, size);
+        }
+    }
+
+    gsl::span<const uint8_t> GetBytes() const
+    {
+        return Span<uint8_t>();
     }
 
     uint32_t flags = ChannelFlags::None;
 
 private:
-    std::vector<uint8_t> data;
+    // Sits in a prefix of its own, so the data stays aligned.
+    // Only the sole owner writes, so the generation needs no atomics.
+    struct Header
+    {
+        std::atomic<uint32_t> refCount;
+        uint64_t generation;
+    };
+    static_assert(sizeof(Header) <= Alignment, "Channel header must fit in the prefix");
+
+    static Header& GetHeader(uint8_t* pData)
+    {
+        return *reinterpret_cast<Header*>(pData - Alignment);
+    }
+
+    // A fresh range of generations for new storage
+    static uint64_t NewGeneration();
+
+    static uint8_t* Allocate(uint32_t size)
+    {
+        auto pBlock = static_cast<uint8_t*>(::operator new(size + Alignment, std::align_val_t(Alignment)));
+        auto pHeader = new (pBlock) Header;
+        pHeader->refCount.store(1, std::memory_order_relaxed);
+        pHeader->generation = NewGeneration();
+        return pBlock + Alignment;
+    }
+
+    static void Free(uint8_t* pData)
+    {
+        if (pData && GetHeader(pData).refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            GetHeader(pData).~Header();
+            ::operator delete(pData - Alignment, std::align_val_t(Alignment));
+        }
+    }
+
+    // Move to new private storage big enough for size, keeping what fits
+    void Reallocate(uint32_t size)
+    {
+        auto capacity = (size + Alignment - 1) & ~(Alignment - 1);
+        uint8_t* pData = nullptr;
+        if (capacity != 0)
+        {
+            pData = Allocate(capacity);
+            auto keep = std::min(m_size, size);
+            if (keep != 0)
+            {
+                memcpy(pData, m_pData, keep);
+            }
+            memset(pData + keep, 0, capacity - keep);
+        }
+        Free(m_pData);
+        m_pData = pData;
+        m_capacity = capacity;
+    }
+
+    void MakeUnique()
+    {
+        if (IsShared())
+        {
+            Reallocate(m_capacity);
+        }
+    }
+
+    // Before handing out writable samples
+    void BeginWrite()
+    {
+        MakeUnique();
+        if (m_pData)
+        {
+            GetHeader(m_pData).generation++;
+        }
+    }
+
+    void Swap(Channel& rhs)
+    {
+        std::swap(m_pData, rhs.m_pData);
+        std::swap(m_size, rhs.m_size);
+        std::swap(m_capacity, rhs.m_capacity);
+        std::swap(flags, rhs.flags);
+    }
+
+    uint8_t* m_pData = nullptr;
+    uint32_t m_size = 0;
+    uint32_t m_capacity = 0;
+};
+
+// Spare channel storage for compute.
+// While a Scope is open on a thread, flow data takes the storage for any new channel from the
+// pool; the graph hands it back once nothing downstream will read it this tick, so buffers with
+// lifetimes that don't overlap share memory.
+class FlowBufferPool
+{
+public:
+    class Scope
+    {
+    public:
+        explicit Scope(FlowBufferPool& pool);
+        ~Scope();
+
+    private:
+        FlowBufferPool* m_pPrevious;
+    };
+
+    // The pool for the open scope on this thread, if any
+    static FlowBufferPool* Current();
+
+    // A zeroed channel of this size
+    Channel Acquire(uint32_t size);
+    void Release(Channel&& channel);
+
+    // Free all the spare storage
+    void Clear();
+
+    size_t GetNumFree() const;
+
+private:
+    // Spare channels by padded size
+    std::unordered_map<uint32_t, std::vector<Channel>> m_free;
+};
+
+// Channels by id. Ids below InlineChannels (the usual case: a few contiguous audio channels)
+// live in a fixed array, so a lookup is a bounds check and an offset; anything higher goes
+// into a vector sorted by id. Iterates in id order, like the std::map it replaces.
+class ChannelMap
+{
+public:
+    static const uint32_t InlineChannels = 8;
+
+    using value_type = std::pair<uint32_t, Channel>;
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ChannelMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator(const ChannelMap* pMap, uint32_t pos)
+            : m_pMap(pMap)
+            , m_pos(pos)
+        {
+            SkipAbsent();
+        }
+
+        reference operator*() const
+        {
+            return m_pos < InlineChannels ? m_pMap->m_dense[m_pos] : m_pMap->m_sparse[m_pos - InlineChannels];
+        }
+        pointer operator->() const
+        {
+            return &**this;
+        }
+        const_iterator& operator++()
+        {
+            m_pos++;
+            SkipAbsent();
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        bool operator==(const const_iterator& rhs) const
+        {
+            return m_pos == rhs.m_pos;
+        }
+        bool operator!=(const const_iterator& rhs) const
+        {
+            return m_pos != rhs.m_pos;
+        }
+
+    private:
+        void SkipAbsent()
+        {
+            while (m_pos < InlineChannels && !(m_pMap->m_denseMask & (1u << m_pos)))
+            {
+                m_pos++;
+            }
+        }
+
+        const ChannelMap* m_pMap;
+        uint32_t m_pos;
+    };
+
+    ChannelMap()
+    {
+        for (uint32_t id = 0; id < InlineChannels; id++)
+        {
+            m_dense[id].first = id;
+        }
+    }
+
+    Channel* Find(uint32_t id)
+    {
+        return const_cast<Channel*>(static_cast<const ChannelMap*>(this)->Find(id));
+    }
+
+    const Channel* Find(uint32_t id) const
+    {
+        if (id < InlineChannels)
+        {
+            return (m_denseMask & (1u << id)) ? &m_dense[id].second : nullptr;
+        }
+
+        auto itr = LowerBound(id);
+        return (itr != m_sparse.end() && itr->first == id) ? &itr->second : nullptr;
+    }
+
+    bool Contains(uint32_t id) const
+    {
+        return Find(id) != nullptr;
+    }
+
+    // Adds an empty channel if there isn't one
+    Channel& operator[](uint32_t id)
+    {
+        if (id < InlineChannels)
+        {
+            if (!(m_denseMask & (1u << id)))
+            {
+                m_denseMask |= (1u << id);
+                m_size++;
+            }
+            return m_dense[id].second;
+        }
+
+        auto itr = LowerBound(id);
+        if (itr == m_sparse.end() || itr->first != id)
+        {
+            itr = m_sparse.insert(itr, value_type(id, Channel()));
+            m_size++;
+        }
+        return itr->second;
+    }
+
+    uint32_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    // Frees the channel memory
+    void clear()
+    {
+        for (auto& channel : m_dense)
+        {
+            channel.second = Channel();
+        }
+        m_sparse.clear();
+        m_denseMask = 0;
+        m_size = 0;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, InlineChannels + uint32_t(m_sparse.size()));
+    }
+
+private:
+    std::vector<value_type>::const_iterator LowerBound(uint32_t id) const
+    {
+        return std::lower_bound(m_sparse.begin(), m_sparse.end(), id, [](const value_type& channel, uint32_t id) {
+            return channel.first < id;
+        });
+    }
+
+    std::vector<value_type>::iterator LowerBound(uint32_t id)
+    {
+        return std::lower_bound(m_sparse.begin(), m_sparse.end(), id, [](const value_type& channel, uint32_t id) {
+            return channel.first < id;
+        });
+    }
+
+    std::array<value_type, InlineChannels> m_dense;
+    uint32_t m_denseMask = 0;
+    uint32_t m_size = 0;
+    std::vector<value_type> m_sparse;
 };
 
 class IFlowData
@@ -70,18 +496,37 @@ public:
     virtual uint32_t GetNumChannels() const = 0; // Number of data channels this flow has
     virtual bool HasChannelId(uint32_t id) const = 0;
     virtual Channel* GetChannelById(uint32_t id, uint32_t size) = 0;
-    virtual const std::map<uint32_t, Channel>& GetChannels() const = 0;
+    virtual const ChannelMap& GetChannels() const = 0;
     
-    virtual void* ToPtr(ParameterType type, uint32_t channel = 0) const = 0;
-    virtual float* ToFloatPtr(uint32_t channel = 0) const = 0;
+    // For reading; the storage may be shared with other flows, so write through GetChannelById
+    // A conversion is kept until the channel is next written, so reading it again is free
+    virtual const void* ToPtr(ParameterType type, uint32_t channel = 0) const = 0;
+    virtual const float* ToFloatPtr(uint32_t channel = 0) const = 0;
+
+    // Convert one sample to type, without converting the whole channel
+    virtual bool ReadSample(ParameterType type, void* pValue, uint32_t channel = 0, uint32_t index = 0) const
+    {
+        auto pData = static_cast<const uint8_t*>(ToPtr(type, channel));
+        if (!pData || index >= GetNumSamples(channel))
+        {
+            return false;
+        }
+        memcpy(pValue, pData + index * GetParameterTypeSize(type), GetParameterTypeSize(type));
+        return true;
+    }
 
     virtual void From(Parameter& value, uint32_t channel = 0) = 0;
     virtual void From(float value, uint32_t channel = 0) = 0;
    
     // Optional copy of all channel data, otherwise just resize to match dimensions
-    // (which may be 'free')
+    // (which may be 'free'). The copy shares the channel storage until one side writes to it.
     virtual void MatchChannelInput(IFlowData& flowData, bool copy = false) = 0;
 
+    // Give the channel storage to the pool, leaving no channels
+    virtual void ReleaseChannels(FlowBufferPool& /*pool*/)
+    {
+    }
+
     virtual ~IFlowData()
     {
     }
@@ -110,11 +555,12 @@ public:
 
     virtual uint32_t GetNumSamples(uint32_t id) const override
     {
-        if (m_data.find(id) == m_data.end())
+        auto pChannel = m_data.Find(id);
+        if (pChannel == nullptr)
         {
             return 0; 
         }
-        return uint32_t(m_data.at(id).ByteSize() / GetParameterTypeSize(m_parameterType));
+        return uint32_t(pChannel->ByteSize() / GetParameterTypeSize(m_parameterType));
     }
 
     virtual ParameterType GetParameterType() const override
@@ -129,20 +575,12 @@ public:
 
     virtual bool HasChannelId(uint32_t id) const override
     {
-        return m_data.find(id) != m_data.end();
+        return m_data.Contains(id);
     }
 
     virtual Channel* GetChannelById(uint32_t id, uint32_t numSamples) override
     {
-        auto channelSize = numSamples * GetParameterTypeSize(m_parameterType);
-        if (m_data.find(id) != m_data.end())
-        {
-            m_data[id].SetSizeInBytes(channelSize);
-            return &m_data[id];
-        }
-
-        m_data[id] = Channel(channelSize);
-        return &m_data[id];
+        return &GetChannel(id, numSamples * GetParameterTypeSize(m_parameterType));
     }
 
     /*virtual bool CanConvert(ParameterType type) const
@@ -159,111 +597,100 @@ public:
     {
         if (copy)
         {
+            // Channels copy by reference
             m_data = flowData.GetChannels();
             return;
         }
 
         for (auto& [id, channel] : flowData.GetChannels())
         {
-            m_data[id].SetSizeInBytes(channel.ByteSize());
-            m_data[id].flags = channel.flags;
+            GetChannel(id, channel.ByteSize()).flags = channel.flags;
         }
     }
 
-    virtual const std::map<uint32_t, Channel>& GetChannels() const override
+    virtual void ReleaseChannels(FlowBufferPool& pool) override
+    {
+        for (auto& [id, channel] : m_data)
+        {
+            pool.Release(std::move(*m_data.Find(id)));
+        }
+        m_data.clear();
+    }
+
+    virtual const ChannelMap& GetChannels() const override
     {
         return m_data;
     }
 
-    virtual void* ToPtr(ParameterType type, uint32_t channel = 0) const override
+    virtual const void* ToPtr(ParameterType type, uint32_t channel = 0) const override
     {
-        if (m_data.find(channel) == m_data.end())
+        auto pChannel = m_data.Find(channel);
+        if (pChannel == nullptr)
         {
             return nullptr;
         }
 
         if (type == m_parameterType)
         {
-            if (m_data.at(channel).ByteSize() == 0)
+            if (pChannel->ByteSize() == 0)
                 return nullptr;
-            return m_data.at(channel).Ptr<uint8_t>();
+            return pChannel->Ptr<uint8_t>();
         }
 
-        if (m_data.empty())
+        auto numSamples = pChannel->ByteSize() / GetParameterTypeSize(m_parameterType);
+        if (numSamples == 0)
         {
             return nullptr;
         }
 
-        auto& ch = m_data.at(channel);
-        auto numSamples = ch.ByteSize() / GetParameterTypeSize(m_parameterType);
-       
-        // Size the temporary buffer : TODO cleaner methods for this
-        auto psize = GetParameterTypeSize(type);
-        m_buffer.resize(psize * numSamples);
-        for (uint32_t sample = 0; sample < numSamples; sample++)
+        // Readers of one output can run together, so the cache is locked.
+        // The first reader of a tick converts; the rest find it current and share the buffer.
+        std::lock_guard<MUtils::audio_spin_mutex> lock(m_convertedMutex);
+
+        // Still good if nothing has written to the channel since it was converted
+        auto& converted = GetConverted(channel, type);
+        if (converted.generation == pChannel->GetGeneration())
         {
-            switch (type)
-            {
-            case ParameterType::Float:
-            {
-                float* pTarget = (float*)&m_buffer[sample * psize];
-                switch (m_parameterType)
-                {
-                case ParameterType::Float:
-                    *pTarget = ch.Val<float>(sample);
-                    break;
-                case ParameterType::Bool:
-                    *pTarget = ch.Val<bool>(sample) ? 1.0f : 0.0f;
-                    break;
-                case ParameterType::Double:
-                    *pTarget = (float)ch.Val<double>(sample);
-                    break;
-                case ParameterType::Int64:
-                    *pTarget = (float)ch.Val<int64_t>(sample);
-                    break;
-                default:
-                    assert(!"Invalid");
-                }
-            }
-            break;
-            case ParameterType::Bool:
-                break;
-            case ParameterType::Double:
-            {
-                double* pTarget = (double*)&m_buffer[sample * psize];
-                switch (m_parameterType)
-                {
-                case ParameterType::Float:
-                    *pTarget = (double)ch.Val<float>(sample);
-                    break;
-                case ParameterType::Bool:
-                    *pTarget = ch.Val<bool>(sample) ? 1.0 : 0.0;
-                    break;
-                case ParameterType::Double:
-                    *pTarget = ch.Val<double>(sample);
-                    break;
-                case ParameterType::Int64:
-                    *pTarget = (double)ch.Val<int64_t>(sample);
-                    break;
-                default:
-                    assert(!"Invalid");
-                }
-            }
-            break;
-            case ParameterType::Int64:
-                break;
-            case ParameterType::String:
-            case ParameterType::None:
-                assert(!"Not happy");
-                break;
-            }
+            return converted.buffer.data();
         }
-        return (void*)&m_buffer[0];
+
+        // Convert in words, so it is aligned for any sample type
+        auto byteSize = GetParameterTypeSize(type) * numSamples;
+        converted.buffer.resize((byteSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        if (!ConvertSamples(m_parameterType, pChannel->Ptr<uint8_t>(), type, converted.buffer.data(), numSamples))
+        {
+            assert(!"Not happy");
+            return nullptr;
+        }
+        converted.generation = pChannel->GetGeneration();
+        return converted.buffer.data();
+    }
+
+    virtual bool ReadSample(ParameterType type, void* pValue, uint32_t channel = 0, uint32_t index = 0) const override
+    {
+        auto pChannel = m_data.Find(channel);
+        auto sampleSize = GetParameterTypeSize(m_parameterType);
+        if (pChannel == nullptr || pChannel->ByteSize() < (index + 1) * sampleSize)
+        {
+            return false;
+        }
+        return ConvertSamples(m_parameterType, pChannel->Ptr<uint8_t>(index * sampleSize), type, pValue, 1);
     }
    
-    virtual float* ToFloatPtr(uint32_t channel = 0) const override
+    virtual const float* ToFloatPtr(uint32_t channel = 0) const override
     {
-        return (float*)ToPtr(ParameterType::Float, channel);
+        return static_cast<const float*>(ToPtr(ParameterType::Float, channel));
+    }
+
+    // Writable samples of a channel, in the flow's own type; gives the channel its own storage first
+    void* WritePtr(uint32_t channel = 0)
+    {
+        auto pChannel = m_data.Find(channel);
+        if (pChannel == nullptr || pChannel->ByteSize() == 0)
+        {
+            return nullptr;
+        }
+        return pChannel->Ptr<uint8_t>();
     }
 
     virtual void From(Parameter& value, uint32_t channel = 0) override
@@ -283,20 +710,281 @@ public:
     virtual void From(float fVal, uint32_t channel = 0) override
     {
         m_parameterType = ParameterType::Float;
-        m_data[channel].SetSizeInBytes(GetParameterTypeSize(m_parameterType));
-        m_data[channel].Val<float>(0) = fVal;
+        GetChannel(channel, GetParameterTypeSize(m_parameterType)).Val<float>(0) = fVal;
     }
 
     virtual void FreeChannels()
     {
         m_data.clear();
+        m_converted.clear();
+    }
+
+protected:
+    // Sized to match; new storage comes from the compute pool if there is one
+    Channel& GetChannel(uint32_t id, uint32_t size)
+    {
+        auto& channel = m_data[id];
+        auto pPool = FlowBufferPool::Current();
+        if (pPool && channel.PaddedByteSize() == 0 && size != 0)
+        {
+            auto flags = channel.flags;
+            channel = pPool->Acquire(size);
+            channel.flags = flags;
+            return channel;
+        }
+
+        channel.SetSizeInBytes(size);
+        return channel;
+    }
+
+    // A channel converted to another sample type by ToPtr
+    struct ConvertedChannel
+    {
+        uint32_t channel;
+        ParameterType type;
+        uint64_t generation = 0; // Of the channel when it was converted; 0 if never
+        std::vector<uint64_t> buffer;
+    };
+
+    // There are only ever a few, so a linear search is fine.
+    // The buffers are kept when the channels go back to the pool, to be reused next tick.
+    // Growing the list moves the buffers without reallocating them, so pointers already handed out stay good.
+    // Call with m_convertedMutex held.
+    ConvertedChannel& GetConverted(uint32_t channel, ParameterType type) const
+    {
+        for (auto& converted : m_converted)
+        {
+            if (converted.channel == channel && converted.type == type)
+            {
+                return converted;
+            }
+        }
+        m_converted.push_back(ConvertedChannel{ channel, type, 0, {} });
+        return m_converted.back();
     }
 
-private:
     uint32_t m_flowType = 0;
     ParameterType m_parameterType;
-    std::map<uint32_t, Channel> m_data;
-    mutable std::vector<uint32_t> m_buffer;
+    ChannelMap m_data;
+    mutable std::vector<ConvertedChannel> m_converted;
+    mutable MUtils::audio_spin_mutex m_convertedMutex;
 };
 
+// Flow data that always holds T samples (float, double, int64_t or bool).
+// Still an IFlowData for generic code, but nodes that know the type can use the spans here:
+// they are not virtual and there is no type switch, so inner loops work on plain T arrays.
+template <class T>
+class TypedFlowData final : public FlowData
+{
+public:
+    static_assert(GetParameterTypeOf<T>() != ParameterType::None, "Flow data samples must be float, double, int64_t or bool");
+
+    explicit TypedFlowData(uint32_t flowType = FlowType_Audio)
+        : FlowData(flowType, GetParameterTypeOf<T>())
+    {
+    }
+
+    // For writing; sizes the channel to numSamples
+    gsl::span<T> GetSamples(uint32_t channel, uint32_t numSamples)
+    {
+        return GetChannel(channel, numSamples * uint32_t(sizeof(T))).template Span<T>();
+    }
+
+    // For reading; empty if there is no such channel
+    gsl::span<const T> GetSamples(uint32_t channel = 0) const
+    {
+        auto pChannel = GetChannels().Find(channel);
+        if (pChannel == nullptr)
+        {
+            return gsl::span<const T>();
+        }
+        return pChannel->template Span<T>();
+    }
+
+    // Storage is only shared with a flow of T; others are sized by sample count and converted to T
+    virtual void MatchChannelInput(IFlowData& flowData, bool copy = false) override
+    {
+        auto sourceType = flowData.GetParameterType();
+        if (sourceType == GetParameterTypeOf<T>())
+        {
+            FlowData::MatchChannelInput(flowData, copy);
+            return;
+        }
+
+        if (copy)
+        {
+            FreeChannels();
+        }
+
+        for (auto& [id, channel] : flowData.GetChannels())
+        {
+            auto numSamples = flowData.GetNumSamples(id);
+            auto& match = GetChannel(id, numSamples * uint32_t(sizeof(T)));
+            match.flags = channel.flags;
+            if (copy && numSamples != 0 && !ConvertSamples(sourceType, channel.template Ptr<uint8_t>(), GetParameterTypeOf<T>(), match.template Ptr<uint8_t>(), numSamples))
+            {
+                throw std::invalid_argument("Flow samples can't be converted to the typed flow's type");
+            }
+        }
+    }
+
+    // Keeps the sample type, where FlowData would switch to float
+    virtual void From(float fVal, uint32_t channel = 0) override
+    {
+        ConvertSamples(ParameterType::Float, &fVal, GetParameterTypeOf<T>(), GetSamples(channel, 1).data(), 1);
+    }
+};
+
+// A timestamped event, such as a MIDI message
+struct FlowEvent
+{
+    uint32_t offset = 0; // Samples from the start of the current block
+    uint8_t status = 0;
+    uint8_t data1 = 0;
+    uint8_t data2 = 0;
+};
+
+// A sparse stream of events, for FlowType_Midi.
+// Events sit in a ring that is allocated once, in time order, so an empty lane costs nothing per
+// block and a busy one never allocates. Events can be queued ahead of the current block; Advance
+// moves the block on and drops what has been played. Readers see the events without consuming
+// them, so an output can feed any number of inputs. There are no dense channels.
+class EventFlowData : public IFlowData
+{
+public:
+    // Capacity is rounded up to a power of two
+    explicit EventFlowData(uint32_t capacity = 256);
+
+    // Queue an event offset samples into the current block (or later); returns false if the ring is full.
+    // Events at the same offset keep the order they were pushed in.
+    bool Push(uint32_t offset, uint8_t status, uint8_t data1 = 0, uint8_t data2 = 0);
+
+    // Call fn(const FlowEvent&) for each event in the first numSamples of the block, in order
+    template <class F>
+    void VisitEvents(uint32_t numSamples, F&& fn) const
+    {
+        for (uint32_t index = 0; index < m_count; index++)
+        {
+            auto event = GetEvent(index);
+            if (event.offset >= numSamples)
+            {
+                break;
+            }
+            fn(event);
+        }
+    }
+
+    // All queued events, in time order
+    FlowEvent GetEvent(uint32_t index) const
+    {
+        auto& slot = m_ring[(m_head + index) & m_mask];
+        FlowEvent event = slot.event;
+        event.offset = uint32_t(slot.time - m_time);
+        return event;
+    }
+
+    uint32_t GetNumEvents() const
+    {
+        return m_count;
+    }
+
+    uint32_t GetCapacity() const
+    {
+        return uint32_t(m_ring.size());
+    }
+
+    // Start the next block numSamples on, dropping the events before it
+    void Advance(uint32_t numSamples);
+
+    void Clear()
+    {
+        m_head = 0;
+        m_count = 0;
+    }
+
+    virtual uint32_t GetFlowType() const override
+    {
+        return FlowType_Midi;
+    }
+
+    virtual ParameterType GetParameterType() const override
+    {
+        return ParameterType::None;
+    }
+
+    virtual uint32_t GetNumSamples(uint32_t /*id*/) const override
+    {
+        return 0;
+    }
+
+    virtual uint32_t GetNumChannels() const override
+    {
+        return 0;
+    }
+
+    virtual bool HasChannelId(uint32_t /*id*/) const override
+    {
+        return false;
+    }
+
+    virtual Channel* GetChannelById(uint32_t /*id*/, uint32_t /*size*/) override
+    {
+        return nullptr;
+    }
+
+    virtual const ChannelMap& GetChannels() const override
+    {
+        return m_noChannels;
+    }
+
+    virtual const void* ToPtr(ParameterType /*type*/, uint32_t /*channel*/ = 0) const override
+    {
+        return nullptr;
+    }
+
+    virtual const float* ToFloatPtr(uint32_t /*channel*/ = 0) const override
+    {
+        return nullptr;
+    }
+
+    // Values don't map to events
+    virtual void From(Parameter& /*value*/, uint32_t /*channel*/ = 0) override
+    {
+    }
+
+    virtual void From(float /*value*/, uint32_t /*channel*/ = 0) override
+    {
+    }
+
+    // Copies the queued events from another event flow, as far as they fit
+    virtual void MatchChannelInput(IFlowData& flowData, bool copy = false) override;
+
+private:
+    struct Slot
+    {
+        uint64_t time; // Absolute, so Advance doesn't have to touch the events
+        FlowEvent event;
+    };
+
+    std::vector<Slot> m_ring;
+    uint32_t m_mask = 0;
+    uint32_t m_head = 0;
+    uint32_t m_count = 0;
+    uint64_t m_time = 0; // Start of the current block
+    ChannelMap m_noChannels;
+};
+
+// The samples of a channel as T, for flows whose type isn't known.
+// No copy if the flow already holds T, otherwise the cached conversion from ToPtr.
+template <class T>
+gsl::span<const T> ReadFlowSamples(const IFlowData& data, uint32_t channel = 0)
+{
+    auto pSamples = static_cast<const T*>(data.ToPtr(GetParameterTypeOf<T>(), channel));
+    if (pSamples == nullptr)
+    {
+        return gsl::span<const T>();
+    }
+    return gsl::span<const T>(pSamples, data.GetNumSamples(channel));
+}
+
 } // namespace NodeGraph
@@ -1,25 +1,221 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <exception>
 #include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
 #include <set>
 #include <map>
+#include <type_traits>
+#include <unordered_map>
 
 #include <nod/nod.hpp>
 
 #include <gsl-lite/gsl-lite.hpp>
 
+#include <concurrentqueue/concurrentqueue.h>
+
 #include "mutils/time/profiler.h"
 
 #include "threadpool/threadpool.h"
 
+#include "nodegraph/model/arena.h"
+#include "nodegraph/model/dense_bitset.h"
+#include "nodegraph/model/execution_plan.h"
 #include "nodegraph/model/node.h"
+#include "nodegraph/model/parameter_ramps.h"
 #include "nodegraph/model/pin.h"
+#include "nodegraph/model/work_stealing.h"
 
 namespace NodeGraph
 {
 
+enum class ComputeMode
+{
+    Serial,
+    // Nodes at the same depth in the graph are computed on the thread pool.
+    // Only use this if node Compute methods don't touch shared state.
+    Parallel,
+    // Nodes are computed as soon as their last flow source finishes, on workers that steal
+    // from each other when idle. Same thread safety rules as Parallel.
+    WorkStealing
+};
+
+// A generation checked reference to a node in a graph; stays invalid once the node is destroyed,
+// even if the slot is reused
+struct NodeHandle
+{
+    static const uint32_t IndexBits = 20;
+    static const uint32_t IndexMask = (1u << IndexBits) - 1;
+    static const uint32_t MaxGeneration = (1u << (32 - IndexBits)) - 1;
+
+    uint32_t value = 0;
+
+    NodeHandle()
+    {
+    }
+
+    NodeHandle(uint32_t index, uint32_t generation)
+        : value((generation << IndexBits) | index)
+    {
+    }
+
+    uint32_t GetIndex() const
+    {
+        return value & IndexMask;
+    }
+
+    uint32_t GetGeneration() const
+    {
+        return value >> IndexBits;
+    }
+
+    // Slot generations start at 1, so a default handle is never valid
+    bool IsValid() const
+    {
+        return value != 0;
+    }
+
+    bool operator==(const NodeHandle& rhs) const
+    {
+        return value == rhs.value;
+    }
+    bool operator!=(const NodeHandle& rhs) const
+    {
+        return value != rhs.value;
+    }
+};
+
+// What an edit of the graph did, gathered until the outermost modify scope closes.
+// Nodes that were made and destroyed in the same edit, and their connections, are left out.
+struct GraphChangeSet
+{
+    struct RemovedNode
+    {
+        NodeHandle handle;
+        uint64_t id = 0;
+    };
+
+    struct Connection
+    {
+        NodeHandle source;
+        NodeHandle target;
+        Pin* pOutput = nullptr;
+        Pin* pInput = nullptr;
+    };
+
+    std::vector<NodeHandle> addedNodes;
+    std::vector<RemovedNode> removedNodes;
+    std::vector<Connection> addedConnections;
+    std::vector<Connection> removedConnections; // Handles and pins may no longer be live
+
+    bool Empty() const
+    {
+        return addedNodes.empty() && removedNodes.empty() && addedConnections.empty() && removedConnections.empty();
+    }
+
+    void Clear()
+    {
+        addedNodes.clear();
+        removedNodes.clear();
+        addedConnections.clear();
+        removedConnections.clear();
+    }
+};
+
+// A change to a pin's value, made on the UI thread and applied by compute
+struct ParameterChange
+{
+    NodeHandle node; // Dropped if the node has gone by the time it is applied
+    Pin* pPin = nullptr;
+    ParameterValue value;
+    bool normalized = false; // value is a Double in 0-1, through the pin's range and taper
+    uint32_t sampleOffset = 0; // Ticks into the compute before a lerp starts; ignored by pins that don't lerp
+};
+
+// The nodes of one type in a graph, cast to T.
+// Points into the graph's type index, so don't hold it across node creation or destruction.
+template <class T>
+class NodeTypeRange
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T* const*;
+        using reference = T*;
+
+        explicit iterator(Node* const* pNode)
+            : m_pNode(pNode)
+        {
+        }
+
+        T* operator*() const
+        {
+            return static_cast<T*>(*m_pNode);
+        }
+        iterator& operator++()
+        {
+            m_pNode++;
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            auto ret = *this;
+            m_pNode++;
+            return ret;
+        }
+        bool operator==(const iterator& rhs) const
+        {
+            return m_pNode == rhs.m_pNode;
+        }
+        bool operator!=(const iterator& rhs) const
+        {
+            return m_pNode != rhs.m_pNode;
+        }
+
+    private:
+        Node* const* m_pNode;
+    };
+
+    NodeTypeRange()
+    {
+    }
+
+    explicit NodeTypeRange(const std::vector<Node*>& nodes)
+        : m_pBegin(nodes.data())
+        , m_pEnd(nodes.data() + nodes.size())
+    {
+    }
+
+    iterator begin() const
+    {
+        return iterator(m_pBegin);
+    }
+    iterator end() const
+    {
+        return iterator(m_pEnd);
+    }
+    bool empty() const
+    {
+        return m_pBegin == m_pEnd;
+    }
+    size_t size() const
+    {
+        return size_t(m_pEnd - m_pBegin);
+    }
+
+private:
+    Node* const* m_pBegin = nullptr;
+    Node* const* m_pEnd = nullptr;
+};
+
 // A collection of nodes that can be computed
 class Graph
 {
@@ -34,10 +230,8 @@ public:
     {
         PreModify();
 
-        auto pNode = new T(*this, std::forward<Args>(args)...);
-        nodes.insert(pNode);
-        m_displayNodes.insert(pNode);
-        m_mapIdToNode[pNode->GetId()] = pNode;
+        auto pNode = m_arena.New<T>(*this, std::forward<Args>(args)...);
+        AddNode(pNode);
 
         PostModify();
         return pNode;
@@ -45,62 +239,223 @@ public:
 
     void DestroyNode(Node* pNode);
 
+    // Nodes, pins and decorators of this graph live here
+    Arena& GetArena()
+    {
+        return m_arena;
+    }
+
     bool IsType(Node& node, ctti::type_id_t type) const;
 
+    // Nodes of exactly this type, from an index kept up to date as nodes come and go
     template <class T>
-    std::set<T*> Find(ctti::type_id_t type) const
+    NodeTypeRange<T> Find(ctti::type_id_t type) const
     {
-        std::set<T*> found;
-        for (auto& pNode : nodes)
+        auto pNodes = GetNodesOfType(type);
+        return pNodes ? NodeTypeRange<T>(*pNodes) : NodeTypeRange<T>();
+    }
+
+    template <class T>
+    std::vector<T*> Find(const std::vector<ctti::type_id_t>& nodeTypes) const
+    {
+        std::vector<T*> found;
+        for (size_t index = 0; index < nodeTypes.size(); index++)
         {
-            if (IsType(*pNode, type))
+            // A type listed twice would give its nodes twice
+            if (std::find(nodeTypes.begin(), nodeTypes.begin() + index, nodeTypes[index]) != nodeTypes.begin() + index)
             {
-                found.insert(static_cast<T*>(pNode));
+                continue;
             }
+
+            auto nodes = Find<T>(nodeTypes[index]);
+            found.insert(found.end(), nodes.begin(), nodes.end());
         }
         return found;
     }
 
-    template <class T>
-    std::set<T*> Find(const std::vector<ctti::type_id_t>& nodeTypes) const
+    // Visit each node reachable from node once, including node itself, walking up sources (PinDir::Input)
+    // or down targets (PinDir::Output) through pins of the given type (ParameterType::None for any).
+    // The visitor takes a Node&; if it returns bool, returning false stops the walk going past that node.
+    // Nodes come in no particular order.
+    // (TNode is only there so that this compiles when node.h has only forward declared Node)
+    template <typename Fn, typename TNode = Node>
+    void VisitNodes(Node& node, PinDir dir, ParameterType type, Fn&& fn)
     {
-        std::set<T*> found;
-        for (auto& t : nodeTypes)
+        auto& root = static_cast<TNode&>(node);
+
+        // A visitor may visit again; give it its own scratch space
+        VisitScratch localScratch;
+        auto& scratch = m_visitInProgress ? localScratch : m_visitScratch;
+        auto wasInProgress = m_visitInProgress;
+        m_visitInProgress = true;
+
+        scratch.visited.Resize(m_nextNodeIndex);
+        scratch.visited.ClearAll();
+        scratch.stack.clear();
+
+        scratch.visited.Set(root.GetIndex());
+        scratch.stack.push_back(&root);
+
+        auto visitNext = [&](TNode& current, TNode& next) {
+            assert(&next != &current);
+            if (!scratch.visited.TestAndSet(next.GetIndex()))
+            {
+                scratch.stack.push_back(&next);
+            }
+        };
+
+        while (!scratch.stack.empty())
         {
-            auto f = Find<T>(t);
-            found.insert(f.begin(), f.end());
+            auto pCurrent = static_cast<TNode*>(scratch.stack.back());
+            scratch.stack.pop_back();
+
+            if constexpr (std::is_same_v<std::invoke_result_t<Fn, Node&>, bool>)
+            {
+                if (!fn(*pCurrent))
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                fn(*pCurrent);
+            }
+
+            if (dir == PinDir::Input)
+            {
+                for (auto& in : pCurrent->GetInputs())
+                {
+                    if ((type == ParameterType::None || type == in->GetType()) && in->GetSource())
+                    {
+                        visitNext(*pCurrent, in->GetSource()->GetOwnerNode());
+                    }
+                }
+            }
+            else
+            {
+                for (auto& out : pCurrent->GetOutputs())
+                {
+                    if (type == ParameterType::None || type == out->GetType())
+                    {
+                        for (auto& pTarget : out->GetTargets())
+                        {
+                            visitNext(*pCurrent, pTarget->GetOwnerNode());
+                        }
+                    }
+                }
+            }
         }
-        return found;
+
+        m_visitInProgress = wasInProgress;
     }
 
+    // Visits a node once for every path to it, depth first in pin order; the return value is ignored.
+    // Prefer VisitNodes, which doesn't blow up on graphs that branch and join.
     void Visit(Node& node, PinDir dir, ParameterType type, std::function<bool(Node&)> fn);
 
+    // Position of the node in an order where every connection goes from a lower to a higher position.
+    // Kept up to date as connections are made, so it is always ready for compute.
+    uint32_t GetTopologicalOrder(const Node& node) const;
+
+    // Called before connecting source to target; reorders the nodes that need it, or throws if the
+    // connection would make a cycle
+    void OrderConnection(Node& source, Node& target);
+
+    // One more than the highest node index in use
+    uint32_t GetNodeIndexCapacity() const
+    {
+        return m_nextNodeIndex;
+    }
+
     // Get the list of pins that could be on the UI
     virtual std::vector<Pin*> GetControlSurface() const;
 
     virtual void Compute(const std::set<Node*>& nodes, int64_t numTicks);
 
-    const std::set<Node*>& GetNodes() const
+    // numThreads = 0 picks one worker per hardware thread, less the calling thread
+    void SetComputeMode(ComputeMode mode, uint32_t numThreads = 0);
+    ComputeMode GetComputeMode() const
     {
-        return nodes;
+        return m_computeMode;
     }
 
-    const std::set<Node*>& GetDisplayNodes() const
+    // Only compute nodes whose inputs changed generation, or whose flow sources were computed this tick
+    void SetIncrementalCompute(bool incremental)
+    {
+        m_incrementalCompute = incremental;
+    }
+    bool GetIncrementalCompute() const
     {
-        return m_displayNodes;
+        return m_incrementalCompute;
     }
+
+    // Share flow channel memory between outputs whose readers are done with them, so only the live
+    // buffers take up cache. Flow outputs are empty after compute, except those of the output nodes
+    // and those read by nodes outside the plan. Only used for serial, non-incremental compute.
+    void SetFlowBufferPooling(bool pooling);
+    bool GetFlowBufferPooling() const
+    {
+        return m_flowBufferPooling;
+    }
+
+    FlowBufferPool& GetFlowBufferPool()
+    {
+        return m_flowBufferPool;
+    }
+
+    // The lerps of all the control pins, advanced at the start of each Compute
+    ParameterRamps& GetParameterRamps()
+    {
+        return m_parameterRamps;
+    }
+
+    // Set a pin from another thread (usually the UI) without locking compute.
+    // The change is queued and applied at the start of the next Compute, before any node runs.
+    // A pin that lerps starts sampleOffset ticks in; one that doesn't changes for the whole tick.
+    // Only numbers can be queued (throws otherwise); set strings from the compute thread.
+    void QueueParameterChange(Pin& pin, const ParameterValue& value, uint32_t sampleOffset = 0);
+    void QueueParameterChangeNormalized(Pin& pin, double value, uint32_t sampleOffset = 0);
+
+    // Apply the queued changes now; Compute does this itself
+    void ApplyParameterChanges();
+
+    // Every node in the graph, packed; the order changes when nodes are destroyed
+    const std::vector<Node*>& GetNodes() const
+    {
+        return m_nodes;
+    }
+
+    NodeHandle GetHandle(const Node& node) const;
+
+    // Null if the node has been destroyed
+    Node* GetNode(NodeHandle handle) const
+    {
+        auto index = handle.GetIndex();
+        if (index >= m_slots.size() || m_slots[index].generation != handle.GetGeneration())
+        {
+            return nullptr;
+        }
+        return m_slots[index].pNode;
+    }
+
+    std::vector<Node*> GetDisplayNodes() const
+    {
+        return GatherNodes(m_displayNodes);
+    }
+    bool IsDisplayNode(const Node& node) const;
     void SetDisplayNodes(const std::set<Node*>& nodes)
     {
-        m_displayNodes = nodes;
+        SetNodeMask(m_displayNodes, nodes);
     }
 
-    const std::set<Node*>& GetOutputNodes() const
+    std::vector<Node*> GetOutputNodes() const
     {
-        return m_outputNodes;
+        return GatherNodes(m_outputNodes);
     }
+    bool IsOutputNode(const Node& node) const;
     void SetOutputNodes(const std::set<Node*>& nodes)
     {
-        m_outputNodes = nodes;
+        SetNodeMask(m_outputNodes, nodes);
     }
 
     void PreModify()
@@ -119,37 +474,125 @@ public:
         m_modifyTracker--;
         if (m_modifyTracker == 0)
         {
+            // Anything could have changed, so the compute order must be rebuilt
+            m_planDirty = true;
             sigEndModify(this);
+            EmitChanges();
         }
     }
 
+    // Called by nodes as pins are connected and disconnected, for the change set
+    void RecordConnection(Pin& output, Pin& input);
+    void RecordDisconnection(Pin& output, Pin& input);
+
     void SetName(const std::string& name);
     std::string Name() const;
 
     // Called to notify that this graph is about to be destroyed
     void NotifyDestroy(Graph* pGraph);
 
-    const std::map<uint64_t, Node*>& GetNodesById() const
+    const std::unordered_map<uint64_t, Node*>& GetNodesById() const
     {
         return m_mapIdToNode;
     }
 
+    Node* GetNodeById(uint64_t id) const
+    {
+        auto itr = m_mapIdToNode.find(id);
+        return itr == m_mapIdToNode.end() ? nullptr : itr->second;
+    }
+
     // Signals
     nod::signal<void(Graph*)> sigBeginModify;
     nod::signal<void(Graph*)> sigEndModify;
+    // Once per outermost modify, after sigEndModify
+    nod::signal<void(Graph*, const GraphChangeSet&)> sigChanged;
     nod::signal<void(Graph*)> sigDestroy;
 
 protected:
+    void AddNode(Node* pNode);
+    uint32_t AllocateNodeIndex();
+    const std::vector<Node*>* GetNodesOfType(ctti::type_id_t type) const;
+    void EmitChanges();
+    static bool EraseConnection(std::vector<GraphChangeSet::Connection>& connections, const GraphChangeSet::Connection& connection);
+    std::vector<Node*> GatherNodes(const DenseBitset& mask) const;
+    void SetNodeMask(DenseBitset& mask, const std::set<Node*>& nodes);
+
+    void ComputeStep(uint32_t stepIndex, int64_t numTicks);
+    bool InputsChanged(uint32_t stepIndex, const Node& node);
+    void ComputeLevels(int64_t numTicks);
+    void ReleaseFlowOutputs(uint32_t stepIndex);
+
+    // Declared first, so it is destroyed after anything that might reference it
+    Arena m_arena;
+
     uint32_t m_modifyTracker = 0;
+    GraphChangeSet m_changes;
+
+    std::unordered_map<uint64_t, Node*> m_mapIdToNode;
+
+    // Slot map of nodes by node index, and the live nodes packed for iteration
+    struct NodeSlot
+    {
+        Node* pNode = nullptr;
+        uint32_t generation = 1;
+        uint32_t packedIndex = 0;
+        uint32_t typeIndex = 0; // Position in its type bucket
+    };
+    std::vector<NodeSlot> m_slots;
+    std::vector<Node*> m_nodes;
 
-    std::map<uint64_t, Node*> m_mapIdToNode;
+    // Live nodes by type hash, packed
+    std::unordered_map<uint64_t, std::vector<Node*>> m_nodesByType;
 
-    std::set<Node*> nodes;
-    std::set<Node*> m_displayNodes;
-    std::set<Node*> m_outputNodes;
+    // Membership by node index
+    DenseBitset m_displayNodes;
+    DenseBitset m_outputNodes;
 
     uint64_t currentGeneration = 1;
     std::string m_strName;
+
+    // Dense node indices, for bitsets and tables keyed by node
+    uint32_t m_nextNodeIndex = 0;
+    std::vector<uint32_t> m_freeNodeIndices;
+
+    struct VisitScratch
+    {
+        DenseBitset visited;
+        std::vector<Node*> stack;
+    };
+    VisitScratch m_visitScratch;
+    bool m_visitInProgress = false;
+
+    // Topological order, by node index
+    std::vector<uint32_t> m_nodeOrder;
+    uint32_t m_nextNodeOrder = 0;
+    DenseBitset m_orderVisited;
+    std::vector<Node*> m_orderStack;
+    std::vector<Node*> m_orderForward;
+    std::vector<Node*> m_orderBackward;
+    std::vector<uint32_t> m_orderPool;
+
+    // Cached compute order for the last set of output nodes
+    ExecutionPlan m_plan;
+    bool m_planDirty = true;
+
+    // Sum of the input generations each step last computed with
+    std::vector<uint64_t> m_stepInputGenerations;
+    bool m_incrementalCompute = false;
+
+    FlowBufferPool m_flowBufferPool;
+    ParameterRamps m_parameterRamps;
+    moodycamel::ConcurrentQueue<ParameterChange> m_parameterChanges;
+    bool m_flowBufferPooling = false;
+
+    ComputeMode m_computeMode = ComputeMode::Serial;
+    uint32_t m_numThreads = 0;
+    std::shared_ptr<ThreadPool> m_spThreadPool;
+    std::vector<std::future<void>> m_computeTasks;
+    std::shared_ptr<WorkStealingScheduler> m_spScheduler;
+    std::function<void(uint32_t)> m_fnComputeStep;
+    int64_t m_computeTicks = 0;
 }; // Graph
 
 } // namespace NodeGraph
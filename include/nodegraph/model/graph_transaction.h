@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nodegraph/model/graph.h"
+
+namespace NodeGraph
+{
+
+// A bulk edit of a graph.
+// Holds the graph in a single modify scope from construction to Commit/Rollback, so listeners
+// see one sigBeginModify/sigEndModify pair and one sigChanged with everything that was done.
+// Nodes are made straight away, so their pins can be used; connections, disconnections and deletions
+// are queued and checked together in Commit before any are applied. Disconnections are applied first,
+// so an input can be rewired in one transaction. If Commit throws, the nodes made by the transaction
+// and any connections it made are removed again, and the ones it broke are restored. Inputs that were
+// generated on nodes from before the transaction stay behind, unconnected.
+class GraphTransaction
+{
+public:
+    explicit GraphTransaction(Graph& graph);
+    ~GraphTransaction();
+
+    GraphTransaction(const GraphTransaction&) = delete;
+    GraphTransaction& operator=(const GraphTransaction&) = delete;
+
+    template <typename T, typename... Args>
+    T* CreateNode(Args&&... args)
+    {
+        CheckOpen();
+        auto pNode = m_graph.CreateNode<T>(std::forward<Args>(args)...);
+        m_created.push_back(m_graph.GetHandle(*pNode));
+        return pNode;
+    }
+
+    // Same rules as Node::ConnectTo
+    void Connect(Node* pSource, Node* pDest, const std::string& outputName = "Flow", const std::string& inputName = "");
+
+    // Break an existing connection; with no input name, whichever input of pDest the output feeds
+    void Disconnect(Node* pSource, Node* pDest, const std::string& outputName = "Flow", const std::string& inputName = "");
+
+    void Destroy(Node* pNode);
+
+    // Check and apply the queued edits; throws std::invalid_argument if any of them can't be done
+    void Commit();
+
+    // Remove the nodes made so far and drop the queued edits
+    void Rollback();
+
+    bool IsOpen() const
+    {
+        return m_open;
+    }
+
+private:
+    struct Connection
+    {
+        NodeHandle source;
+        NodeHandle dest;
+        std::string outputName;
+        std::string inputName;
+        Pin* pOutput = nullptr;
+        Pin* pInput = nullptr; // Null if the input will be generated
+    };
+
+    void CheckOpen() const;
+    Node* GetLiveNode(NodeHandle handle) const;
+    void Validate();
+    void Close();
+
+    Graph& m_graph;
+    bool m_open = true;
+    std::vector<NodeHandle> m_created;
+    std::vector<Connection> m_connections;
+    std::vector<Connection> m_disconnections;
+    std::vector<NodeHandle> m_destroyed;
+};
+
+} // namespace NodeGraph
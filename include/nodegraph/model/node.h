@@ -3,9 +3,11 @@
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <ctti/type_id.hpp>
+#include <mutils/string/string_utils.h>
 
 #include "pin.h"
 
@@ -85,7 +87,9 @@ enum
 {
     None = (0),
     Hidden = (1 << 0),
-    OwnerDraw = (1 << 1)
+    OwnerDraw = (1 << 1),
+    // Output depends on more than the inputs (time, internal state), so incremental compute can't skip it
+    AlwaysCompute = (1 << 2)
 };
 
 };
@@ -154,32 +158,60 @@ public:
     const std::vector<Pin*>& GetFlowControlInputs() const;
     const std::vector<Pin*>& GetFlowControlOutputs() const;
 
+    // Inputs are searched before outputs
     Pin* GetPin(const std::string& name) const;
 
+    // No hashing; for callers that resolve the same names many times
+    Pin* GetPinById(const MUtils::StringId& id) const;
+
+    Pin* GetInput(const std::string& name) const;
+    Pin* GetOutput(const std::string& name) const;
+
+    // The hash used to index pins, the same as MUtils::StringId
+    static uint32_t HashPinName(const std::string& name);
+
     // Make an output pin
     template<typename T, typename = std::enable_if_t<!std::is_pointer<T>::value>>
     Pin* AddOutput(const std::string& strName, T val, const ParameterAttributes& attrib = ParameterAttributes{})
     {
         GraphModify __modify(m_graph);
-        m_outputs.push_back(new Pin(*this, PinDir::Output, strName, val, attrib));
-        return m_outputs[m_outputs.size() - 1];
+        m_outputs.push_back(new (AllocatePin()) Pin(*this, PinDir::Output, strName, val, attrib));
+        return IndexPin(m_outputs.back());
     }
 
     Pin* AddOutputFlow(const std::string& strName, IFlowData* val, const ParameterAttributes& attrib = ParameterAttributes{});
 
+    // Make an output with a TypedFlowData<T> that the node owns
+    template <class T>
+    Pin* AddOutputFlow(const std::string& strName, uint32_t flowType = FlowType_Audio, const ParameterAttributes& attrib = ParameterAttributes{})
+    {
+        return AddOutputFlow(strName, NewFlowData<T>(flowType), attrib);
+    }
+
     // Make an input pin
     template<typename T, typename = std::enable_if_t<!std::is_pointer<T>::value>>
     Pin* AddInput(const std::string& strName, T val, const ParameterAttributes& attrib = ParameterAttributes{})
     {
         GraphModify __modify(m_graph);
-        m_inputs.push_back(new Pin(*this, PinDir::Input, strName, val, attrib));
-        return m_inputs[m_inputs.size() - 1];
+        m_inputs.push_back(new (AllocatePin()) Pin(*this, PinDir::Input, strName, val, attrib));
+        return IndexPin(m_inputs.back());
     }
 
     Pin* AddInputFlow(const std::string& strName, IFlowData* val, const ParameterAttributes& attrib = ParameterAttributes{});
 
+    // Make an input with a TypedFlowData<T> that the node owns
+    template <class T>
+    Pin* AddInputFlow(const std::string& strName, uint32_t flowType = FlowType_Audio, const ParameterAttributes& attrib = ParameterAttributes{})
+    {
+        return AddInputFlow(strName, NewFlowData<T>(flowType), attrib);
+    }
+
+    // Takes ownership of a decorator made with new
     NodeDecorator* AddDecorator(NodeDecorator* decorator);
 
+    // Makes the decorator in the graph's arena
+    NodeDecorator* AddDecorator(DecoratorType type, const std::string& name = std::string());
+
     const std::vector<NodeDecorator*>& GetDecorators() const;
     void ClearDecorators();
 
@@ -205,6 +237,12 @@ public:
         return m_Id;
     }
 
+    // Dense index of this node in its graph; reused after the node is destroyed
+    uint32_t GetIndex() const
+    {
+        return m_index;
+    }
+
     const MUtils::NVec2f& GetPos() const
     {
         return m_viewPos;
@@ -226,8 +264,28 @@ public:
     nod::signal<void(Node*)> sigDestroy;
 
 protected:
+    friend class Graph;
+
+    // Memory for a pin, from the graph's arena
+    void* AllocatePin();
+
+    // Flow data in the graph's arena, destroyed with the node
+    template <class T>
+    TypedFlowData<T>* NewFlowData(uint32_t flowType)
+    {
+        auto pData = new (AllocateFlowData(sizeof(TypedFlowData<T>), alignof(TypedFlowData<T>))) TypedFlowData<T>(flowType);
+        m_flowData.push_back(pData);
+        return pData;
+    }
+    void* AllocateFlowData(size_t size, size_t align);
+
+    // Add a new pin to the name index
+    Pin* IndexPin(Pin* pPin);
+    Pin* FindPin(const std::unordered_map<uint32_t, Pin*>& index, const std::vector<Pin*>& pins, uint32_t hash, const std::string& name) const;
+
     uint64_t m_Id;
     static uint64_t CurrentId;
+    uint32_t m_index = 0;
     ctti::type_id_t m_nodeType;
     std::string m_strName;
     std::vector<Pin*> m_inputs;
@@ -239,6 +297,9 @@ protected:
     mutable std::vector<Pin*> m_flowControlInputs;
     mutable std::vector<Pin*> m_flowControlOutputs;
     std::vector<NodeDecorator*> m_decorators;
+    std::vector<IFlowData*> m_flowData; // Made by the typed AddInputFlow/AddOutputFlow
+    std::unordered_map<uint32_t, Pin*> m_inputIndex;  // Name hash to first input of that name
+    std::unordered_map<uint32_t, Pin*> m_outputIndex; // Name hash to first output of that name
     uint64_t m_generation = 0;
     MUtils::NRectf m_viewCells;
     MUtils::NVec2f m_gridScale = MUtils::NVec2f(1.0f);
@@ -1,15 +1,20 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <functional>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_set>
 #include <variant>
 #include <vector>
 
+#include <gsl-lite/gsl-lite.hpp>
+
 #include <nodegraph/model/memory.h>
 #include <nodegraph/view/layout_control.h>
 
@@ -18,6 +23,8 @@ namespace NodeGraph
 
 // Data that flows between nodes, of generic type
 class IFlowData;
+class ParameterRamps;
+class AutomationTimeline;
 
 enum class ParameterType
 {
@@ -52,6 +59,46 @@ inline uint32_t GetParameterTypeSize(ParameterType type)
     }
 }
 
+// The sample type that holds a T, or None
+template <class T>
+constexpr ParameterType GetParameterTypeOf()
+{
+    if constexpr (std::is_same_v<T, float>)
+    {
+        return ParameterType::Float;
+    }
+    else if constexpr (std::is_same_v<T, double>)
+    {
+        return ParameterType::Double;
+    }
+    else if constexpr (std::is_same_v<T, int64_t>)
+    {
+        return ParameterType::Int64;
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        return ParameterType::Bool;
+    }
+    else
+    {
+        return ParameterType::None;
+    }
+}
+
+// The text of a string value; shared between copies, and never changed once made
+struct ParameterString
+{
+    explicit ParameterString(const std::string& val)
+        : str(val)
+    {
+    }
+
+    std::atomic<uint32_t> refCount{ 1 };
+    std::string str;
+};
+
+// A tagged 16 byte value.
+// Strings live out of line, so the numbers that make up almost every parameter don't pay for them.
 struct ParameterValue
 {
     union
@@ -61,47 +108,70 @@ struct ParameterValue
         int64_t iVal;
         bool bVal;
         IFlowData* pFVal;
+        ParameterString* pSVal;
     };
-    std::string sVal;
     ParameterType type = ParameterType::None;
 
     ~ParameterValue()
     {
+        ReleaseString();
     }
 
     ParameterValue()
+        : iVal(0)
     {
     }
 
     ParameterValue(const ParameterValue& val)
+        : iVal(val.iVal)
+        , type(val.type)
+    {
+        // The union is copied whole; a shared string just needs another reference
+        if (type == ParameterType::String)
+        {
+            pSVal->refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ParameterValue(ParameterValue&& val) noexcept
+        : iVal(val.iVal)
+        , type(val.type)
+    {
+        val.type = ParameterType::None;
+    }
+
+    ParameterValue& operator=(const ParameterValue& val)
     {
+        if (val.type == ParameterType::String)
+        {
+            val.pSVal->refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        ReleaseString();
+        iVal = val.iVal;
         type = val.type;
-        switch (val.type)
+        return *this;
+    }
+
+    ParameterValue& operator=(ParameterValue&& val) noexcept
+    {
+        if (this != &val)
         {
-        case ParameterType::Float:
-            fVal = val.fVal;
-            break;
-        case ParameterType::Double:
-            dVal = val.dVal;
-            break;
-        case ParameterType::Int64:
+            ReleaseString();
             iVal = val.iVal;
-            break;
-        case ParameterType::Bool:
-            bVal = val.bVal;
-            break;
-        case ParameterType::String:
-            sVal = val.sVal;
-            break;
-        case ParameterType::FlowData:
-            pFVal = val.pFVal;
-            break;
-        default:
-            break;
+            type = val.type;
+            val.type = ParameterType::None;
         }
+        return *this;
+    }
+
+    // Empty unless this is a string
+    const std::string& GetString() const
+    {
+        static const std::string Empty;
+        return type == ParameterType::String ? pSVal->str : Empty;
     }
 
-    bool operator==(const ParameterValue& val)
+    bool operator==(const ParameterValue& val) const
     {
         if (type != val.type)
             return false;
@@ -121,7 +191,7 @@ struct ParameterValue
             return bVal == val.bVal;
             break;
         case ParameterType::String:
-            return sVal == val.sVal;
+            return pSVal == val.pSVal || pSVal->str == val.pSVal->str;
             break;
         case ParameterType::FlowData:
             return pFVal == val.pFVal;
@@ -160,7 +230,7 @@ struct ParameterValue
     {
         if (type != ParameterType::String)
             return false;
-        return sVal == val;
+        return pSVal->str == val;
     }
     bool operator==(const IFlowData* const& val)
     {
@@ -217,7 +287,7 @@ struct ParameterValue
     }
     explicit ParameterValue(const std::string& str)
     {
-        sVal = str;
+        pSVal = new ParameterString(str);
         type = ParameterType::String;
     }
     explicit ParameterValue(IFlowData* const& ptr)
@@ -278,18 +348,19 @@ struct ParameterValue
         bVal = v;
         return bVal;
     }
-    std::string& operator=(const std::string& v)
+    const std::string& operator=(const std::string& v)
     {
-        if (type == ParameterType::None)
-        {
-            type = ParameterType::String;
-        }
-        if (type != ParameterType::String)
+        if (type != ParameterType::None && type != ParameterType::String)
         {
             throw std::invalid_argument("Not a string!");
         }
-        sVal = v;
-        return sVal;
+
+        // Strings are shared, so a new one replaces the old rather than writing into it
+        auto pString = new ParameterString(v);
+        ReleaseString();
+        pSVal = pString;
+        type = ParameterType::String;
+        return pSVal->str;
     }
 
     IFlowData* operator=(IFlowData* const& v)
@@ -336,7 +407,7 @@ struct ParameterValue
         {
             throw std::invalid_argument("Not a string!");
         }
-        return sVal;
+        return pSVal->str;
     }
     explicit operator IFlowData*() const
     {
@@ -351,8 +422,19 @@ struct ParameterValue
     T To() const;
     template <class T>
     void SetFrom(const T& value);
+
+private:
+    void ReleaseString()
+    {
+        if (type == ParameterType::String && pSVal->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete pSVal;
+        }
+    }
 };
 
+static_assert(sizeof(ParameterValue) <= 16, "ParameterValue should stay compact");
+
 template <class T>
 inline T ParameterValue::To() const
 {
@@ -397,7 +479,7 @@ inline std::string ParameterValue::To() const
         return ":Flow";
     default:
     case ParameterType::String:
-        return sVal;
+        return GetString();
     }
 };
 
@@ -422,7 +504,7 @@ inline void ParameterValue::SetFrom(const T& value)
     }
     else if (type == ParameterType::String)
     {
-        value = (T)sVal;
+        value = (T)GetString();
     }
     else if (type == ParameterType::FlowData)
     {
@@ -516,16 +598,34 @@ public:
     }
 };
 
+// What Parameter::UpdateBlock did with the block
+enum class BlockFill
+{
+    None, // Not a number; the block is untouched
+    Constant, // The value holds for the whole block, which is untouched
+    Samples // The block holds the value at each tick
+};
+
 // A parameter is a variant type that can also lerp
 class Parameter
 {
 public:
     Parameter()
+        : m_spAttributes(InternAttributes(ParameterAttributes{}))
     {
     }
 
     ~Parameter()
     {
+        if (m_rampSlot != NoRamp)
+        {
+            SyncRamp(true);
+        }
+        if (m_automationSlot != NoRamp)
+        {
+            SetAutomation(nullptr);
+        }
+
         // Remove ourselves from the double linked list
         if (m_pNextShadow)
         {
@@ -571,9 +671,14 @@ public:
                 }
                 // m_value stays where it is
                 m_startValue = m_value;
-                m_startTick = m_currentTick;
+                m_startTick = m_pRamps ? RampTick() : m_currentTick;
                 m_endValue = val;
             }
+
+            if (m_pRamps)
+            {
+                SyncRamp();
+            }
         }
 
         // Walk outwards to the shadow variables
@@ -591,7 +696,7 @@ public:
     explicit Parameter(const Parameter& rhs)
         : m_value(rhs.m_value)
         , m_initValue(rhs.m_initValue)
-        , m_attributes(rhs.m_attributes)
+        , m_spAttributes(rhs.m_spAttributes)
         , m_endValue(rhs.m_endValue)
         , m_currentTick(rhs.m_currentTick)
         , m_lerpTicks(rhs.m_lerpTicks)
@@ -603,7 +708,7 @@ public:
     explicit Parameter(float val, const ParameterAttributes& attrib = ParameterAttributes{})
         : m_value(val)
         , m_initValue(val)
-        , m_attributes(attrib)
+        , m_spAttributes(InternAttributes(attrib))
     {
         Set(val, true);
     }
@@ -611,7 +716,7 @@ public:
     explicit Parameter(double val, const ParameterAttributes& attrib = ParameterAttributes{})
         : m_value(val)
         , m_initValue(val)
-        , m_attributes(attrib)
+        , m_spAttributes(InternAttributes(attrib))
     {
         Set(val, true);
     }
@@ -619,7 +724,7 @@ public:
     explicit Parameter(int64_t val, const ParameterAttributes& attrib = ParameterAttributes{})
         : m_value(val)
         , m_initValue(val)
-        , m_attributes(attrib)
+        , m_spAttributes(InternAttributes(attrib))
     {
         Set(val, true);
     }
@@ -627,85 +732,73 @@ public:
     explicit Parameter(bool val, const ParameterAttributes& attrib = ParameterAttributes{})
         : m_value(val)
         , m_initValue(val)
-        , m_attributes(attrib)
+        , m_spAttributes(InternAttributes(attrib))
     {
         Set(val, true);
-        m_attributes.ui = ParameterUI::Button;
+        if (m_spAttributes->ui != ParameterUI::Button)
+        {
+            auto attributes = attrib;
+            attributes.ui = ParameterUI::Button;
+            m_spAttributes = InternAttributes(attributes);
+        }
     }
 
     explicit Parameter(const std::string& val, const ParameterAttributes& attrib = ParameterAttributes{})
         : m_value(val)
         , m_initValue(val)
-        , m_attributes(attrib)
+        , m_spAttributes(InternAttributes(attrib))
     {
         Set(val, true);
-        m_attributes.ui = ParameterUI::Text;
+        if (m_spAttributes->ui != ParameterUI::Text)
+        {
+            auto attributes = attrib;
+            attributes.ui = ParameterUI::Text;
+            m_spAttributes = InternAttributes(attributes);
+        }
     }
 
     explicit Parameter(IFlowData* val, const ParameterAttributes& attrib = ParameterAttributes{})
         : m_value(val)
         , m_initValue(val)
-        , m_attributes(attrib)
+        , m_spAttributes(InternAttributes(attrib))
     {
     }
 
     void SetAttributes(const ParameterAttributes& attributes)
     {
-        m_attributes = attributes;
+        m_spAttributes = InternAttributes(attributes);
     }
 
-    ParameterAttributes& GetAttributes()
+    const ParameterAttributes& GetAttributes() const
     {
-        return m_attributes;
+        return *m_spAttributes;
     }
 
+    // Change the attributes through fn, which is given a copy; the result is shared like any other.
+    // The shared blocks are never changed in place.
+    template <class Fn>
+    void ModifyAttributes(Fn&& fn)
+    {
+        auto attributes = *m_spAttributes;
+        fn(attributes);
+        m_spAttributes = InternAttributes(attributes);
+    }
+
+    // A shared block equal to attributes; parameters made with the same attributes share one
+    static std::shared_ptr<const ParameterAttributes> InternAttributes(const ParameterAttributes& attributes);
+
     // Get a value and convert from flow data 
     template <class T>
     T To() const
     {
-        // This is a reintepret cast of flow data to a scalar value
-        if (m_value.type == ParameterType::FlowData)
+        // The first sample of the flow data, converted to T
+        if constexpr (GetParameterTypeOf<T>() != ParameterType::None)
         {
-            void* pData = nullptr;
-
-            // Convert the flow data to a stream of the same data type
-            // Then read the memory address: TODO: Optimize
-            if (std::is_same_v<T, float>)
-            {
-                pData = m_value.pFVal->ToPtr(ParameterType::Float);
-                if (!pData)
-                {
-                    return T(0.0f); 
-                }
-            }
-            else if (std::is_same_v<T, double>)
+            if (m_value.type == ParameterType::FlowData)
             {
-                pData = m_value.pFVal->ToPtr(ParameterType::Double);
-                if (!pData)
-                {
-                    return T(0.0); 
-                }
-            }
-            else if (std::is_same_v<T, int64_t>)
-            {
-                pData = m_value.pFVal->ToPtr(ParameterType::Int64);
-                if (!pData)
-                {
-                    return T(0); 
-                }
-            }
-            else if (std::is_same_v<T, bool>)
-            {
-                pData = m_value.pFVal->ToPtr(ParameterType::Bool);
-                if (!pData)
-                {
-                    return T(false); 
-                }
-            }
-
-            if (pData)
-            {
-                return *((T*)pData);
+                T value = T(0);
+                m_value.pFVal->ReadSample(GetParameterTypeOf<T>(), &value);
+                return value;
             }
         }
         return m_value.To<T>();
@@ -730,6 +823,11 @@ public:
     {
         m_currentTick = tick;
 
+        if (m_spAutomation)
+        {
+            return UpdateAutomation(tick);
+        }
+
         if (m_endValue == m_value)
         {
             return m_value;
@@ -749,7 +847,8 @@ public:
             return m_value;
         }
 
-        float frac = m_lerpTicks != 0 ? ((float)(tick - m_startTick) / m_lerpTicks) : 1.0f;
+        // Signed, so a tick before the start of the lerp clamps to 0 rather than wrapping
+        float frac = m_lerpTicks != 0 ? ((float)(int64_t(tick) - m_startTick) / m_lerpTicks) : 1.0f;
         frac = std::min(frac, 1.0f);
         frac = std::max(frac, 0.0f);
         if (frac <= 1.0f)
@@ -784,6 +883,11 @@ public:
         return m_value;
     }
 
+    // Fill block with the value at each tick from tick, as floats, for sample accurate smoothing.
+    // Leaves the parameter updated to the last tick. The caller owns the buffer, so idle parameters
+    // carry none. A settled parameter doesn't touch the block; the caller can use its value instead.
+    BlockFill UpdateBlock(uint64_t tick, gsl::span<float> block);
+
     ParameterType GetType() const
     {
         return m_value.type;
@@ -799,12 +903,6 @@ public:
         return m_lerpTicks;
     }
 
-    template <class T>
-    inline T To()
-    {
-        return m_value.To<T>();
-    }
-
     template <class T>
     void SetFrom(const T& value)
     {
@@ -836,6 +934,10 @@ public:
         m_endValue = p.m_endValue;
         m_value = p.m_value;
         m_startTick = p.m_startTick;
+        if (m_pRamps)
+        {
+            SyncRamp();
+        }
 
         if (forward)
         {
@@ -875,6 +977,27 @@ public:
         return m_generation;
     }
 
+    // Lerps are then advanced by the ramps (once per tick, for all of them) instead of by Update
+    void SetRamps(ParameterRamps* pRamps)
+    {
+        m_pRamps = pRamps;
+    }
+
+    bool IsRamping() const
+    {
+        return m_rampSlot != NoRamp;
+    }
+
+    // Drive the value from a timeline; null to stop. While it is set, Update and UpdateBlock read
+    // the timeline, and it overrides anything Set from the next tick on.
+    // With ramps, the parameter is walked with them every tick.
+    void SetAutomation(std::shared_ptr<AutomationTimeline> spTimeline);
+
+    const std::shared_ptr<AutomationTimeline>& GetAutomation() const
+    {
+        return m_spAutomation;
+    }
+
     const ParameterValue& GetInitValue() const
     {
         return m_initValue;
@@ -928,8 +1051,8 @@ protected:
 
     ParameterValue m_initValue;
 
-    // Settings for how to display
-    ParameterAttributes m_attributes;
+    // Settings for how to display; shared, so change them through ModifyAttributes
+    std::shared_ptr<const ParameterAttributes> m_spAttributes;
 
     // How many ticks to lerp
     int32_t m_lerpTicks = 0;
@@ -945,6 +1068,26 @@ protected:
     // Shadow parameters
     Parameter* m_pNextShadow = nullptr;
     Parameter* m_pPrevShadow = nullptr;
+
+private:
+    friend class ParameterRamps;
+    static constexpr uint32_t NoRamp = 0xFFFFFFFF;
+
+    // Register with the ramps while lerping, and only then
+    void SyncRamp(bool destroying = false);
+
+    // The ramps' current tick, where lerps start
+    int64_t RampTick() const;
+
+    // Take the value at tick from the timeline
+    ParameterValue UpdateAutomation(uint64_t tick);
+
+    ParameterRamps* m_pRamps = nullptr;
+    uint32_t m_rampSlot = NoRamp; // Index in the ramps
+
+    std::shared_ptr<AutomationTimeline> m_spAutomation;
+    uint32_t m_automationCursor = 0; // Our place in the timeline
+    uint32_t m_automationSlot = NoRamp; // Index in the ramps' automated parameters
 };
 
 } // namespace NodeGraph
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <concurrentqueue/concurrentqueue.h>
+
+#include "nodegraph/model/parameter.h"
+
+namespace NodeGraph
+{
+
+// The lerps of every parameter in a graph that is moving, kept as structure of arrays.
+// A parameter is only in here between being set and reaching its end value, so idle ones
+// cost nothing per tick; Advance moves all the rest in one pass that the compiler can vectorize.
+// Float, Double and Int64 parameters lerp; anything else is set straight away.
+// Parameters with an automation timeline are walked here too, after the lerps, so the timeline wins.
+// Owned by the thread that runs compute, so nothing here locks: other threads queue their changes
+// on the graph. While nodes compute on workers (inside a WorkerScope), a lerp that is started or
+// stopped is handed over through a lock-free queue and takes effect when the scope closes.
+class ParameterRamps
+{
+public:
+    ParameterRamps() = default;
+    ParameterRamps(const ParameterRamps&) = delete;
+    ParameterRamps& operator=(const ParameterRamps&) = delete;
+
+    // Start or restart a lerp from the parameter's start value to its end value, from its start tick
+    void Add(Parameter& param);
+    void Remove(Parameter& param);
+
+    // Open while nodes compute on worker threads
+    class WorkerScope
+    {
+    public:
+        explicit WorkerScope(ParameterRamps& ramps);
+        ~WorkerScope();
+
+    private:
+        ParameterRamps& m_ramps;
+    };
+
+    // Hold back the start of a lerp that was just added, so it begins part way into the tick
+    void Delay(Parameter& param, uint32_t ticks);
+
+    // For an output whose node just computed. A lerp started on it this tick is moved back to the
+    // previous tick and on to this one, as outputs used to be updated after their node computed;
+    // the nodes that read it later in the tick then see it moving. Safe on workers inside a WorkerScope.
+    void CatchUp(Parameter& param);
+
+    // Walk this parameter's automation timeline every tick, until it is removed
+    void AddAutomation(Parameter& param);
+    void RemoveAutomation(Parameter& param);
+
+    // Move every lerp to tick, writing the values back and dropping the ones that have finished,
+    // then move every automated parameter to tick
+    void Advance(int64_t tick);
+
+    int64_t GetTick() const
+    {
+        return m_tick;
+    }
+
+    size_t GetNumRamps() const
+    {
+        return m_params.size();
+    }
+
+    size_t GetNumAutomated() const
+    {
+        return m_automated.size();
+    }
+
+private:
+    void SyncHandOver();
+
+    int64_t m_tick = 0;
+    int64_t m_previousTick = 0;
+
+    std::vector<double> m_starts;
+    std::vector<double> m_deltas; // End - start
+    std::vector<double> m_startTicks;
+    std::vector<double> m_tickScales; // 1 / lerp ticks
+    std::vector<double> m_values;
+    std::vector<Parameter*> m_params;
+
+    std::vector<Parameter*> m_automated;
+
+    // Parameters set on workers, to sync once they are done
+    bool m_workers = false;
+    moodycamel::ConcurrentQueue<Parameter*> m_handOver;
+};
+
+} // namespace NodeGraph
@@ -52,13 +52,22 @@ public:
 
     void Detach()
     {
+        // Unhook the other end too, so nothing is left pointing at us
         if (m_direction == PinDir::Input)
         {
+            if (m_pSource)
+            {
+                m_pSource->RemoveTarget(this);
+            }
             m_pSource = nullptr;
             assert(m_targets.empty());
         }
         else
         {
+            for (auto& pTarget : m_targets)
+            {
+                pTarget->m_pSource = nullptr;
+            }
             m_targets.clear();
             assert(m_pSource == nullptr);
         }
@@ -76,6 +85,13 @@ public:
         }
         return m_pSource->GetFlowData();
     }
+
+    // Null unless the flow here (or at the source, for a connected input) is a TypedFlowData<T>
+    template <class T>
+    TypedFlowData<T>* GetTypedFlowData() const
+    {
+        return dynamic_cast<TypedFlowData<T>*>(GetFlowData());
+    }
     
     virtual ParameterValue Update(uint64_t tick) override
     {
@@ -111,9 +127,9 @@ public:
                     data.resize(DisplayDataSize);
 
                     // Copy the new data onto the end of our buffer, shuffling the existing along
-                    auto& vec = chPair.second.GetVector();
-                    memmove(&data[0], &data[vec.size()], (DisplayDataSize - vec.size()));
-                    memcpy(&data[DisplayDataSize - vec.size()], &vec[0], vec.size());
+                    auto bytes = chPair.second.GetBytes();
+                    memmove(&data[0], &data[bytes.size()], (DisplayDataSize - bytes.size()));
+                    memcpy(&data[DisplayDataSize - bytes.size()], bytes.data(), bytes.size());
 
                     #ifdef DEBUG
                     if (pData->GetParameterType() == ParameterType::Float)
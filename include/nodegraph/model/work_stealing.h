@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <mutils/thread/thread_utils.h>
+
+#include "nodegraph/model/execution_plan.h"
+
+namespace NodeGraph
+{
+
+// Runs the steps of an execution plan on a set of worker threads.
+// Every step holds a count of sources that haven't finished; the last source to finish
+// pushes it onto its own worker's queue. Idle workers steal from the other end of
+// other workers' queues, so a long chain doesn't hold up the rest of the graph.
+class WorkStealingScheduler
+{
+public:
+    // The thread calling Run also does work, so this is the number of extra threads
+    explicit WorkStealingScheduler(uint32_t numWorkers);
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    // Call fnStep with the index of every step in the plan, each after all of its sources.
+    // Returns when every step is done; rethrows the first exception thrown by a step
+    void Run(const ExecutionPlan& plan, const std::function<void(uint32_t)>& fnStep);
+
+    uint32_t GetNumWorkers() const
+    {
+        return uint32_t(m_workers.size());
+    }
+
+private:
+    // Owner pushes and pops at the bottom, thieves take from the top.
+    // Each step is pushed once per run, so the queue never wraps.
+    struct WorkQueue
+    {
+        MUtils::audio_spin_mutex mutex;
+        std::vector<uint32_t> steps;
+        uint32_t top = 0;
+        uint32_t bottom = 0;
+    };
+
+    void Prepare(const ExecutionPlan& plan);
+    void Push(uint32_t worker, uint32_t step);
+    bool Pop(uint32_t worker, uint32_t& step);
+    bool Steal(uint32_t worker, uint32_t& step);
+    void Execute(uint32_t worker);
+    void WorkerThread(uint32_t worker);
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_pending;
+    size_t m_pendingSize = 0;
+
+    // The run in progress
+    const ExecutionPlan* m_pPlan = nullptr;
+    const std::function<void(uint32_t)>* m_pStep = nullptr;
+    std::atomic<uint32_t> m_remaining{ 0 };
+    std::atomic<bool> m_abort{ false };
+    std::exception_ptr m_exception;
+    std::mutex m_exceptionMutex;
+
+    // Wakes the workers for a new run
+    std::mutex m_runMutex;
+    std::condition_variable m_runStart;
+    std::condition_variable m_runDone;
+    uint64_t m_runGeneration = 0;
+    uint32_t m_busyWorkers = 0;
+    bool m_quit = false;
+};
+
+} // namespace NodeGraph
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cassert>
+
+#include "nodegraph/model/arena.h"
+
+namespace NodeGraph
+{
+
+namespace
+{
+const uint64_t ArenaMagic = 0x4e4f444541524e41; // 'NODEARNA'
+}
+
+Arena::Arena(size_t blockSize)
+    : m_blockSize(std::max(blockSize, MaxSmallSize * 2))
+    , m_freeLists(MaxSmallSize / Granularity + 1, nullptr)
+{
+    static_assert(sizeof(Header) == Granularity, "Header must keep allocations aligned");
+}
+
+Arena::~Arena()
+{
+    FreeLarge();
+    for (auto& pBlock : m_blocks)
+    {
+        ::operator delete(pBlock);
+    }
+}
+
+void Arena::NewBlock()
+{
+    auto pBlock = static_cast<uint8_t*>(::operator new(m_blockSize));
+    m_blocks.push_back(pBlock);
+    m_pCurrent = pBlock;
+    m_pEnd = pBlock + m_blockSize;
+}
+
+void* Arena::Allocate(size_t size, size_t align)
+{
+    if (size > MaxSmallSize || align > Granularity)
+    {
+        return AllocateLarge(size, align);
+    }
+
+    auto sizeClass = uint32_t((std::max(size, size_t(1)) + Granularity - 1) / Granularity);
+
+    // Reuse a freed slot of the same size if we have one
+    Header* pHeader = nullptr;
+    auto& pFree = m_freeLists[sizeClass];
+    if (pFree)
+    {
+        pHeader = reinterpret_cast<Header*>(pFree) - 1;
+        pFree = pFree->pNext;
+    }
+    else
+    {
+        auto totalSize = sizeof(Header) + sizeClass * Granularity;
+        if (!m_pCurrent || size_t(m_pEnd - m_pCurrent) < totalSize)
+        {
+            NewBlock();
+        }
+        pHeader = reinterpret_cast<Header*>(m_pCurrent);
+        m_pCurrent += totalSize;
+    }
+
+    pHeader->sizeClass = sizeClass;
+    pHeader->offset = 0;
+    pHeader->magic = ArenaMagic;
+    return pHeader + 1;
+}
+
+void* Arena::AllocateLarge(size_t size, size_t align)
+{
+    // Room for the header in front of the aligned object; the base is aligned too, so the object is
+    align = std::max(align, Granularity);
+    auto pBase = static_cast<uint8_t*>(::operator new(size + align, std::align_val_t(align)));
+    auto pObject = pBase + align;
+
+    auto pHeader = reinterpret_cast<Header*>(pObject) - 1;
+    pHeader->sizeClass = LargeClass;
+    pHeader->offset = uint32_t(align);
+    pHeader->magic = ArenaMagic;
+    m_large[pObject] = size;
+    return pObject;
+}
+
+void Arena::Free(void* pMemory)
+{
+    if (!pMemory)
+    {
+        return;
+    }
+
+    auto pHeader = static_cast<Header*>(pMemory) - 1;
+    assert(pHeader->magic == ArenaMagic);
+
+    if (pHeader->sizeClass == LargeClass)
+    {
+        m_large.erase(static_cast<uint8_t*>(pMemory));
+        ::operator delete(static_cast<uint8_t*>(pMemory) - pHeader->offset, std::align_val_t(pHeader->offset));
+        return;
+    }
+
+    auto pNode = static_cast<FreeNode*>(pMemory);
+    pNode->pNext = m_freeLists[pHeader->sizeClass];
+    m_freeLists[pHeader->sizeClass] = pNode;
+}
+
+void Arena::FreeLarge()
+{
+    for (auto& [pObject, size] : m_large)
+    {
+        auto offset = (reinterpret_cast<Header*>(pObject) - 1)->offset;
+        ::operator delete(pObject - offset, std::align_val_t(offset));
+    }
+    m_large.clear();
+}
+
+void Arena::Reset()
+{
+    FreeLarge();
+    for (size_t block = 1; block < m_blocks.size(); block++)
+    {
+        ::operator delete(m_blocks[block]);
+    }
+
+    if (!m_blocks.empty())
+    {
+        m_blocks.resize(1);
+        m_pCurrent = m_blocks[0];
+        m_pEnd = m_pCurrent + m_blockSize;
+    }
+
+    for (auto& pFree : m_freeLists)
+    {
+        pFree = nullptr;
+    }
+}
+
+bool Arena::Owns(const void* pMemory) const
+{
+    auto pByte = static_cast<const uint8_t*>(pMemory);
+    for (auto& pBlock : m_blocks)
+    {
+        if (pByte >= pBlock && pByte < pBlock + m_blockSize)
+        {
+            return true;
+        }
+    }
+
+    // The last large allocation starting at or before the memory
+    auto itr = m_large.upper_bound(const_cast<uint8_t*>(pByte));
+    if (itr != m_large.begin())
+    {
+        --itr;
+        return pByte < itr->first + itr->second;
+    }
+    return false;
+}
+
+} // namespace NodeGraph
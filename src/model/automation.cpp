@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "nodegraph/model/automation.h"
+#include "nodegraph/model/flow_convert.h"
+
+namespace NodeGraph
+{
+
+AutomationTimeline::AutomationTimeline(uint32_t capacity)
+    : m_capacity(capacity)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("Automation timeline needs room for at least one point");
+    }
+    m_points.reserve(capacity);
+}
+
+bool AutomationTimeline::Add(int64_t tick, double value, float curve)
+{
+    if (m_points.size() >= m_capacity)
+    {
+        return false;
+    }
+
+    // Within the reserved capacity, so this never allocates
+    auto itr = std::upper_bound(m_points.begin(), m_points.end(), tick, [](int64_t t, const AutomationPoint& point) {
+        return t < point.tick;
+    });
+    m_points.insert(itr, AutomationPoint{ tick, value, curve });
+    return true;
+}
+
+void AutomationTimeline::Trim(int64_t tick)
+{
+    uint32_t cursor = 0;
+    Seek(tick, cursor);
+    m_points.erase(m_points.begin(), m_points.begin() + cursor);
+}
+
+void AutomationTimeline::Clear()
+{
+    m_points.clear();
+}
+
+void AutomationTimeline::Seek(int64_t tick, uint32_t& cursor) const
+{
+    auto size = uint32_t(m_points.size());
+    if (size == 0)
+    {
+        cursor = 0;
+        return;
+    }
+
+    // Gone backwards (or the points changed); find it again
+    if (cursor >= size || m_points[cursor].tick > tick)
+    {
+        auto itr = std::upper_bound(m_points.begin(), m_points.end(), tick, [](int64_t t, const AutomationPoint& point) {
+            return t < point.tick;
+        });
+        cursor = itr == m_points.begin() ? 0 : uint32_t(itr - m_points.begin() - 1);
+        return;
+    }
+
+    while (cursor + 1 < size && m_points[cursor + 1].tick <= tick)
+    {
+        cursor++;
+    }
+}
+
+double AutomationTimeline::SegmentValue(uint32_t index, int64_t tick) const
+{
+    auto& from = m_points[index];
+    auto& to = m_points[index + 1];
+    auto frac = double(tick - from.tick) / double(to.tick - from.tick);
+    if (from.curve != 0.0f)
+    {
+        frac = std::expm1(from.curve * frac) / std::expm1(double(from.curve));
+    }
+    return from.value + (to.value - from.value) * frac;
+}
+
+double AutomationTimeline::ValueAt(int64_t tick, uint32_t& cursor) const
+{
+    if (m_points.empty())
+    {
+        return 0.0;
+    }
+
+    Seek(tick, cursor);
+    auto& point = m_points[cursor];
+    if (tick <= point.tick || cursor + 1 == m_points.size())
+    {
+        return point.value;
+    }
+    return SegmentValue(cursor, tick);
+}
+
+void AutomationTimeline::Render(int64_t tick, float* pOut, uint32_t count, uint32_t& cursor) const
+{
+    if (m_points.empty())
+    {
+        std::fill(pOut, pOut + count, 0.0f);
+        return;
+    }
+
+    // A segment at a time
+    uint32_t done = 0;
+    while (done < count)
+    {
+        auto now = tick + done;
+        Seek(now, cursor);
+        auto& point = m_points[cursor];
+
+        // Flat before the first point
+        if (now < point.tick)
+        {
+            auto run = uint32_t(std::min<int64_t>(count - done, point.tick - now));
+            std::fill(pOut + done, pOut + done + run, float(point.value));
+            done += run;
+            continue;
+        }
+
+        // Flat after the last
+        if (cursor + 1 == m_points.size())
+        {
+            std::fill(pOut + done, pOut + count, float(point.value));
+            break;
+        }
+
+        auto& next = m_points[cursor + 1];
+        auto run = uint32_t(std::min<int64_t>(count - done, next.tick - now));
+        if (point.curve == 0.0f)
+        {
+            auto step = (next.value - point.value) / double(next.tick - point.tick);
+            FillRamp(pOut + done, run, float(point.value + step * double(now - point.tick)), float(step));
+        }
+        else
+        {
+            for (uint32_t index = 0; index < run; index++)
+            {
+                pOut[done + index] = float(SegmentValue(cursor, now + index));
+            }
+        }
+        done += run;
+    }
+}
+
+} // namespace NodeGraph
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cassert>
+
+#include "nodegraph/model/execution_plan.h"
+#include "nodegraph/model/graph.h"
+
+namespace NodeGraph
+{
+
+namespace
+{
+const uint32_t PlanIndex_None = 0xFFFFFFFF;
+
+// Get the node driving this input, if it is a connected flow input
+Node* GetFlowSourceNode(const Pin& pin)
+{
+    if (pin.GetDirection() != PinDir::Input || pin.GetType() != ParameterType::FlowData)
+    {
+        return nullptr;
+    }
+
+    auto pSource = pin.GetSource();
+    return pSource ? &pSource->GetOwnerNode() : nullptr;
+}
+} // namespace
+
+void ExecutionPlan::Clear()
+{
+    m_roots.clear();
+    m_steps.clear();
+    m_sources.clear();
+    m_targets.clear();
+    m_levelSteps.clear();
+    m_levelOffsets.clear();
+    m_releaseSteps.clear();
+    m_releaseOffsets.clear();
+}
+
+bool ExecutionPlan::Matches(const std::set<Node*>& outNodes) const
+{
+    return m_roots.size() == outNodes.size() && std::equal(m_roots.begin(), m_roots.end(), outNodes.begin());
+}
+
+void ExecutionPlan::Build(Graph& graph, const std::set<Node*>& outNodes)
+{
+    Clear();
+
+    m_roots.assign(outNodes.begin(), outNodes.end());
+
+    // Gather everything the outputs pull flow from
+    std::vector<uint32_t> planIndex(graph.GetNodeIndexCapacity(), PlanIndex_None);
+    std::vector<Node*> planNodes;
+    for (auto& pRoot : m_roots)
+    {
+        graph.VisitNodes(*pRoot, PinDir::Input, ParameterType::FlowData, [&](Node& node) {
+            if (planIndex[node.GetIndex()] != PlanIndex_None)
+            {
+                // Already have this one and everything above it
+                return false;
+            }
+            planIndex[node.GetIndex()] = 0;
+            planNodes.push_back(&node);
+            return true;
+        });
+    }
+
+    // The graph keeps its topological order up to date as connections are made
+    std::sort(planNodes.begin(), planNodes.end(), [&](Node* pLeft, Node* pRight) {
+        return graph.GetTopologicalOrder(*pLeft) < graph.GetTopologicalOrder(*pRight);
+    });
+
+    for (uint32_t index = 0; index < uint32_t(planNodes.size()); index++)
+    {
+        planIndex[planNodes[index]->GetIndex()] = index;
+    }
+
+    for (auto& pNode : planNodes)
+    {
+        PlanStep step;
+        step.pNode = pNode;
+        step.firstSource = uint32_t(m_sources.size());
+        for (auto& pInput : pNode->GetInputs())
+        {
+            auto pSourceNode = GetFlowSourceNode(*pInput);
+            if (!pSourceNode)
+            {
+                continue;
+            }
+
+            auto sourceIndex = planIndex[pSourceNode->GetIndex()];
+            assert(sourceIndex < m_steps.size());
+
+            auto itrBegin = m_sources.begin() + step.firstSource;
+            if (std::find(itrBegin, m_sources.end(), sourceIndex) == m_sources.end())
+            {
+                m_sources.push_back(sourceIndex);
+                step.level = std::max(step.level, m_steps[sourceIndex].level + 1);
+            }
+        }
+        step.numSources = uint32_t(m_sources.size()) - step.firstSource;
+        m_steps.push_back(step);
+    }
+
+    BuildTargets();
+    BuildLevels();
+    BuildReleases(planIndex);
+}
+
+void ExecutionPlan::BuildTargets()
+{
+    // Invert the source lists, so each step knows who is waiting on it
+    for (auto& step : m_steps)
+    {
+        for (uint32_t source = 0; source < step.numSources; source++)
+        {
+            m_steps[m_sources[step.firstSource + source]].numTargets++;
+        }
+    }
+
+    uint32_t offset = 0;
+    for (auto& step : m_steps)
+    {
+        step.firstTarget = offset;
+        offset += step.numTargets;
+        step.numTargets = 0;
+    }
+
+    m_targets.resize(offset);
+    for (uint32_t index = 0; index < uint32_t(m_steps.size()); index++)
+    {
+        auto& step = m_steps[index];
+        for (uint32_t source = 0; source < step.numSources; source++)
+        {
+            auto& sourceStep = m_steps[m_sources[step.firstSource + source]];
+            m_targets[sourceStep.firstTarget + sourceStep.numTargets++] = index;
+        }
+    }
+}
+
+void ExecutionPlan::BuildLevels()
+{
+    // Bucket the steps by level, keeping plan order inside each level
+    uint32_t numLevels = 0;
+    for (auto& step : m_steps)
+    {
+        numLevels = std::max(numLevels, step.level + 1);
+    }
+
+    m_levelOffsets.assign(numLevels + 1, 0);
+    for (auto& step : m_steps)
+    {
+        m_levelOffsets[step.level + 1]++;
+    }
+
+    for (uint32_t level = 0; level < numLevels; level++)
+    {
+        m_levelOffsets[level + 1] += m_levelOffsets[level];
+    }
+
+    std::vector<uint32_t> insert(m_levelOffsets.begin(), m_levelOffsets.end() - 1);
+    m_levelSteps.resize(m_steps.size());
+    for (uint32_t index = 0; index < uint32_t(m_steps.size()); index++)
+    {
+        m_levelSteps[insert[m_steps[index].level]++] = index;
+    }
+}
+
+void ExecutionPlan::BuildReleases(const std::vector<uint32_t>& planIndex)
+{
+    // The last reader of a step's outputs, in plan order; None if they must be kept
+    std::vector<uint32_t> lastUse(m_steps.size(), PlanIndex_None);
+    for (uint32_t index = 0; index < uint32_t(m_steps.size()); index++)
+    {
+        // Roots are sorted, coming from a set
+        auto& step = m_steps[index];
+        if (std::binary_search(m_roots.begin(), m_roots.end(), step.pNode))
+        {
+            continue;
+        }
+
+        bool external = false;
+        for (auto& pOutput : step.pNode->GetFlowOutputs())
+        {
+            for (auto& pTarget : pOutput->GetTargets())
+            {
+                external |= planIndex[pTarget->GetOwnerNode().GetIndex()] == PlanIndex_None;
+            }
+        }
+        if (external)
+        {
+            continue;
+        }
+
+        // Targets come after the step, so with none the outputs are dead as soon as it is done
+        lastUse[index] = index;
+        auto pTargets = GetTargets(step);
+        for (uint32_t target = 0; target < step.numTargets; target++)
+        {
+            lastUse[index] = std::max(lastUse[index], pTargets[target]);
+        }
+    }
+
+    m_releaseOffsets.assign(m_steps.size() + 1, 0);
+    for (auto& use : lastUse)
+    {
+        if (use != PlanIndex_None)
+        {
+            m_releaseOffsets[use + 1]++;
+        }
+    }
+
+    for (uint32_t index = 0; index < uint32_t(m_steps.size()); index++)
+    {
+        m_releaseOffsets[index + 1] += m_releaseOffsets[index];
+    }
+
+    std::vector<uint32_t> insert(m_releaseOffsets.begin(), m_releaseOffsets.end() - 1);
+    m_releaseSteps.resize(m_releaseOffsets.back());
+    for (uint32_t index = 0; index < uint32_t(m_steps.size()); index++)
+    {
+        if (lastUse[index] != PlanIndex_None)
+        {
+            m_releaseSteps[insert[lastUse[index]]++] = index;
+        }
+    }
+}
+
+} // namespace NodeGraph
@@ -0,0 +1,337 @@
+#include <cstring>
+#include <type_traits>
+
+#include "nodegraph/model/flow_convert.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define NODEGRAPH_CONVERT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NODEGRAPH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NODEGRAPH_TARGET_AVX2
+#endif
+
+namespace NodeGraph
+{
+
+namespace
+{
+
+const uint32_t NumSampleTypes = 4;
+
+// Row/column in the kernel table, or NumSampleTypes if it isn't a sample type
+uint32_t SampleTypeIndex(ParameterType type)
+{
+    switch (type)
+    {
+    case ParameterType::Float:
+        return 0;
+    case ParameterType::Double:
+        return 1;
+    case ParameterType::Int64:
+        return 2;
+    case ParameterType::Bool:
+        return 3;
+    default:
+        return NumSampleTypes;
+    }
+}
+
+template <class TFrom, class TTo>
+TTo ConvertOne(TFrom value)
+{
+    if constexpr (std::is_same_v<TTo, bool>)
+    {
+        return value != TFrom(0);
+    }
+    else
+    {
+        return TTo(value);
+    }
+}
+
+// Bools are read as bytes, so anything non-zero is true
+template <class TFrom>
+TFrom LoadSample(const uint8_t* pSource)
+{
+    if constexpr (std::is_same_v<TFrom, bool>)
+    {
+        return *pSource != 0;
+    }
+    else
+    {
+        TFrom value;
+        memcpy(&value, pSource, sizeof(TFrom));
+        return value;
+    }
+}
+
+template <class TFrom, class TTo>
+void ConvertScalarFrom(const void* pSource, void* pDest, uint32_t start, uint32_t count)
+{
+    auto pIn = static_cast<const uint8_t*>(pSource);
+    auto pOut = static_cast<uint8_t*>(pDest);
+    for (uint32_t sample = start; sample < count; sample++)
+    {
+        auto value = ConvertOne<TFrom, TTo>(LoadSample<TFrom>(pIn + sample * sizeof(TFrom)));
+        memcpy(pOut + sample * sizeof(TTo), &value, sizeof(TTo));
+    }
+}
+
+template <class TFrom, class TTo>
+void ConvertScalar(const void* pSource, void* pDest, uint32_t count)
+{
+    ConvertScalarFrom<TFrom, TTo>(pSource, pDest, 0, count);
+}
+
+template <class T>
+void ConvertCopy(const void* pSource, void* pDest, uint32_t count)
+{
+    memcpy(pDest, pSource, size_t(count) * sizeof(T));
+}
+
+#ifdef NODEGRAPH_CONVERT_X86
+
+void FloatToDoubleSSE2(const void* pSource, void* pDest, uint32_t count)
+{
+    auto pIn = static_cast<const float*>(pSource);
+    auto pOut = static_cast<double*>(pDest);
+    uint32_t sample = 0;
+    for (; sample + 4 <= count; sample += 4)
+    {
+        auto in = _mm_loadu_ps(pIn + sample);
+        _mm_storeu_pd(pOut + sample, _mm_cvtps_pd(in));
+        _mm_storeu_pd(pOut + sample + 2, _mm_cvtps_pd(_mm_movehl_ps(in, in)));
+    }
+    ConvertScalarFrom<float, double>(pSource, pDest, sample, count);
+}
+
+void DoubleToFloatSSE2(const void* pSource, void* pDest, uint32_t count)
+{
+    auto pIn = static_cast<const double*>(pSource);
+    auto pOut = static_cast<float*>(pDest);
+    uint32_t sample = 0;
+    for (; sample + 4 <= count; sample += 4)
+    {
+        auto low = _mm_cvtpd_ps(_mm_loadu_pd(pIn + sample));
+        auto high = _mm_cvtpd_ps(_mm_loadu_pd(pIn + sample + 2));
+        _mm_storeu_ps(pOut + sample, _mm_movelh_ps(low, high));
+    }
+    ConvertScalarFrom<double, float>(pSource, pDest, sample, count);
+}
+
+void FloatToBoolSSE2(const void* pSource, void* pDest, uint32_t count)
+{
+    auto pIn = static_cast<const float*>(pSource);
+    auto pOut = static_cast<uint8_t*>(pDest);
+    auto zero = _mm_setzero_ps();
+    auto one = _mm_set1_epi8(1);
+    uint32_t sample = 0;
+    for (; sample + 16 <= count; sample += 16)
+    {
+        // All ones where non-zero, packed down to bytes and masked to 1
+        auto a = _mm_castps_si128(_mm_cmpneq_ps(_mm_loadu_ps(pIn + sample), zero));
+        auto b = _mm_castps_si128(_mm_cmpneq_ps(_mm_loadu_ps(pIn + sample + 4), zero));
+        auto c = _mm_castps_si128(_mm_cmpneq_ps(_mm_loadu_ps(pIn + sample + 8), zero));
+        auto d = _mm_castps_si128(_mm_cmpneq_ps(_mm_loadu_ps(pIn + sample + 12), zero));
+        auto bytes = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + sample), _mm_and_si128(bytes, one));
+    }
+    ConvertScalarFrom<float, bool>(pSource, pDest, sample, count);
+}
+
+void BoolToFloatSSE2(const void* pSource, void* pDest, uint32_t count)
+{
+    auto pIn = static_cast<const uint8_t*>(pSource);
+    auto pOut = static_cast<float*>(pDest);
+    auto zero = _mm_setzero_si128();
+    auto one = _mm_set1_epi8(1);
+    uint32_t sample = 0;
+    for (; sample + 4 <= count; sample += 4)
+    {
+        int32_t packed;
+        memcpy(&packed, pIn + sample, sizeof(packed));
+        auto bytes = _mm_min_epu8(_mm_cvtsi32_si128(packed), one);
+        auto ints = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+        _mm_storeu_ps(pOut + sample, _mm_cvtepi32_ps(ints));
+    }
+    ConvertScalarFrom<bool, float>(pSource, pDest, sample, count);
+}
+
+NODEGRAPH_TARGET_AVX2 void FloatToDoubleAVX2(const void* pSource, void* pDest, uint32_t count)
+{
+    auto pIn = static_cast<const float*>(pSource);
+    auto pOut = static_cast<double*>(pDest);
+    uint32_t sample = 0;
+    for (; sample + 8 <= count; sample += 8)
+    {
+        _mm256_storeu_pd(pOut + sample, _mm256_cvtps_pd(_mm_loadu_ps(pIn + sample)));
+        _mm256_storeu_pd(pOut + sample + 4, _mm256_cvtps_pd(_mm_loadu_ps(pIn + sample + 4)));
+    }
+    ConvertScalarFrom<float, double>(pSource, pDest, sample, count);
+}
+
+NODEGRAPH_TARGET_AVX2 void DoubleToFloatAVX2(const void* pSource, void* pDest, uint32_t count)
+{
+    auto pIn = static_cast<const double*>(pSource);
+    auto pOut = static_cast<float*>(pDest);
+    uint32_t sample = 0;
+    for (; sample + 8 <= count; sample += 8)
+    {
+        auto low = _mm256_cvtpd_ps(_mm256_loadu_pd(pIn + sample));
+        auto high = _mm256_cvtpd_ps(_mm256_loadu_pd(pIn + sample + 4));
+        _mm256_storeu_ps(pOut + sample, _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1));
+    }
+    ConvertScalarFrom<double, float>(pSource, pDest, sample, count);
+}
+
+NODEGRAPH_TARGET_AVX2 void BoolToFloatAVX2(const void* pSource, void* pDest, uint32_t count)
+{
+    auto pIn = static_cast<const uint8_t*>(pSource);
+    auto pOut = static_cast<float*>(pDest);
+    auto one = _mm_set1_epi8(1);
+    uint32_t sample = 0;
+    for (; sample + 8 <= count; sample += 8)
+    {
+        auto bytes = _mm_min_epu8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pIn + sample)), one);
+        _mm256_storeu_ps(pOut + sample, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)));
+    }
+    ConvertScalarFrom<bool, float>(pSource, pDest, sample, count);
+}
+
+bool HasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // The OS has to save the YMM registers too
+    __cpuid(info, 1);
+    const int OSXSave = 1 << 27;
+    const int AVX = 1 << 28;
+    if ((info[2] & (OSXSave | AVX)) != (OSXSave | AVX) || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // NODEGRAPH_CONVERT_X86
+
+struct KernelTable
+{
+    ConvertKernel kernels[NumSampleTypes][NumSampleTypes];
+    const char* pszName = "Scalar";
+
+    KernelTable()
+    {
+        // Every pair has a scalar kernel; the SIMD ones replace the busy pairs.
+        // SSE2 and AVX2 have no 64 bit integer to float conversion, so Int64 stays scalar.
+        kernels[0][0] = ConvertCopy<float>;
+        kernels[0][1] = ConvertScalar<float, double>;
+        kernels[0][2] = ConvertScalar<float, int64_t>;
+        kernels[0][3] = ConvertScalar<float, bool>;
+        kernels[1][0] = ConvertScalar<double, float>;
+        kernels[1][1] = ConvertCopy<double>;
+        kernels[1][2] = ConvertScalar<double, int64_t>;
+        kernels[1][3] = ConvertScalar<double, bool>;
+        kernels[2][0] = ConvertScalar<int64_t, float>;
+        kernels[2][1] = ConvertScalar<int64_t, double>;
+        kernels[2][2] = ConvertCopy<int64_t>;
+        kernels[2][3] = ConvertScalar<int64_t, bool>;
+        kernels[3][0] = ConvertScalar<bool, float>;
+        kernels[3][1] = ConvertScalar<bool, double>;
+        kernels[3][2] = ConvertScalar<bool, int64_t>;
+        kernels[3][3] = ConvertCopy<bool>;
+
+#ifdef NODEGRAPH_CONVERT_X86
+        // SSE2 is always there on x64
+        pszName = "SSE2";
+        kernels[0][1] = FloatToDoubleSSE2;
+        kernels[1][0] = DoubleToFloatSSE2;
+        kernels[0][3] = FloatToBoolSSE2;
+        kernels[3][0] = BoolToFloatSSE2;
+
+        if (HasAVX2())
+        {
+            pszName = "AVX2";
+            kernels[0][1] = FloatToDoubleAVX2;
+            kernels[1][0] = DoubleToFloatAVX2;
+            kernels[3][0] = BoolToFloatAVX2;
+        }
+#endif
+    }
+};
+
+const KernelTable& GetKernelTable()
+{
+    static const KernelTable table;
+    return table;
+}
+
+} // namespace
+
+ConvertKernel GetConvertKernel(ParameterType from, ParameterType to)
+{
+    auto fromIndex = SampleTypeIndex(from);
+    auto toIndex = SampleTypeIndex(to);
+    if (fromIndex == NumSampleTypes || toIndex == NumSampleTypes)
+    {
+        return nullptr;
+    }
+    return GetKernelTable().kernels[fromIndex][toIndex];
+}
+
+bool ConvertSamples(ParameterType from, const void* pSource, ParameterType to, void* pDest, uint32_t count)
+{
+    auto kernel = GetConvertKernel(from, to);
+    if (!kernel)
+    {
+        return false;
+    }
+    kernel(pSource, pDest, count);
+    return true;
+}
+
+const char* GetConvertKernelSet()
+{
+    return GetKernelTable().pszName;
+}
+
+void FillRamp(float* pDest, uint32_t count, float start, float step)
+{
+    uint32_t sample = 0;
+#ifdef NODEGRAPH_CONVERT_X86
+    auto starts = _mm_set1_ps(start);
+    auto steps = _mm_set1_ps(step);
+    auto four = _mm_set1_ps(4.0f);
+    auto index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    for (; sample + 4 <= count; sample += 4)
+    {
+        _mm_storeu_ps(pDest + sample, _mm_add_ps(starts, _mm_mul_ps(steps, index)));
+        index = _mm_add_ps(index, four);
+    }
+#endif
+    for (; sample < count; sample++)
+    {
+        pDest[sample] = start + step * float(sample);
+    }
+}
+
+} // namespace NodeGraph
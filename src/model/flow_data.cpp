@@ -0,0 +1,143 @@
+#include "nodegraph/model/flow_data.h"
+
+namespace NodeGraph
+{
+
+namespace
+{
+thread_local FlowBufferPool* pCurrentPool = nullptr;
+std::atomic<uint64_t> nextStorageId{ 1 };
+}
+
+uint64_t Channel::NewGeneration()
+{
+    // Each allocation counts up from its own high word, so no two ever meet
+    return nextStorageId.fetch_add(1, std::memory_order_relaxed) << 32;
+}
+
+FlowBufferPool::Scope::Scope(FlowBufferPool& pool)
+    : m_pPrevious(pCurrentPool)
+{
+    pCurrentPool = &pool;
+}
+
+FlowBufferPool::Scope::~Scope()
+{
+    pCurrentPool = m_pPrevious;
+}
+
+FlowBufferPool* FlowBufferPool::Current()
+{
+    return pCurrentPool;
+}
+
+Channel FlowBufferPool::Acquire(uint32_t size)
+{
+    auto padded = (size + Channel::Alignment - 1) & ~(Channel::Alignment - 1);
+    auto itr = m_free.find(padded);
+    if (itr == m_free.end() || itr->second.empty())
+    {
+        return Channel(size);
+    }
+
+    // Released channels are zeroed, so this is just a size change
+    auto channel = std::move(itr->second.back());
+    itr->second.pop_back();
+    channel.SetSizeInBytes(size);
+    return channel;
+}
+
+void FlowBufferPool::Release(Channel&& channel)
+{
+    // Still being read through another flow; just drop our reference
+    if (channel.PaddedByteSize() == 0 || channel.IsShared())
+    {
+        channel = Channel();
+        return;
+    }
+
+    channel.SetSizeInBytes(0);
+    channel.flags = ChannelFlags::None;
+    m_free[channel.PaddedByteSize()].push_back(std::move(channel));
+}
+
+void FlowBufferPool::Clear()
+{
+    m_free.clear();
+}
+
+size_t FlowBufferPool::GetNumFree() const
+{
+    size_t count = 0;
+    for (auto& [size, channels] : m_free)
+    {
+        count += channels.size();
+    }
+    return count;
+}
+
+EventFlowData::EventFlowData(uint32_t capacity)
+{
+    uint32_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    m_ring.resize(size);
+    m_mask = size - 1;
+}
+
+bool EventFlowData::Push(uint32_t offset, uint8_t status, uint8_t data1, uint8_t data2)
+{
+    if (m_count == m_ring.size())
+    {
+        return false;
+    }
+
+    // Usually in order already; otherwise shuffle later events up to make room
+    auto time = m_time + offset;
+    auto index = m_count;
+    while (index > 0 && m_ring[(m_head + index - 1) & m_mask].time > time)
+    {
+        m_ring[(m_head + index) & m_mask] = m_ring[(m_head + index - 1) & m_mask];
+        index--;
+    }
+
+    auto& slot = m_ring[(m_head + index) & m_mask];
+    slot.time = time;
+    slot.event.offset = 0;
+    slot.event.status = status;
+    slot.event.data1 = data1;
+    slot.event.data2 = data2;
+    m_count++;
+    return true;
+}
+
+void EventFlowData::Advance(uint32_t numSamples)
+{
+    m_time += numSamples;
+    while (m_count > 0 && m_ring[m_head].time < m_time)
+    {
+        m_head = (m_head + 1) & m_mask;
+        m_count--;
+    }
+}
+
+void EventFlowData::MatchChannelInput(IFlowData& flowData, bool copy)
+{
+    auto pEvents = dynamic_cast<EventFlowData*>(&flowData);
+    if (!copy || pEvents == nullptr || pEvents == this)
+    {
+        return;
+    }
+
+    Clear();
+    auto count = std::min(pEvents->GetNumEvents(), GetCapacity());
+    for (uint32_t index = 0; index < count; index++)
+    {
+        auto event = pEvents->GetEvent(index);
+        Push(event.offset, event.status, event.data1, event.data2);
+    }
+}
+
+} // namespace NodeGraph
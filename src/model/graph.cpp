@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <exception>
+#include <limits>
 #include <stdexcept>
+#include <thread>
 
 #include <mutils/logger/logger.h>
 #include <mutils/thread/thread_utils.h>
@@ -29,12 +32,52 @@ void Graph::DestroyNode(Node* pNode)
     }
     PreModify();
 
-    nodes.erase(pNode);
-    m_displayNodes.erase(pNode);
-    m_outputNodes.erase(pNode);
+    auto index = pNode->GetIndex();
+    auto& slot = m_slots[index];
+    assert(slot.pNode == pNode);
+
+    m_changes.removedNodes.push_back({ GetHandle(*pNode), pNode->GetId() });
+
+    // The node's connections go with it; recorded while its handle is still good
+    for (auto& pInput : pNode->GetInputs())
+    {
+        if (auto pSource = pInput->GetSource())
+        {
+            // Only const through the input; the graph owns both pins
+            RecordDisconnection(const_cast<Pin&>(*pSource), *pInput);
+        }
+    }
+    for (auto& pOutput : pNode->GetOutputs())
+    {
+        for (auto& pTarget : pOutput->GetTargets())
+        {
+            RecordDisconnection(*pOutput, *pTarget);
+        }
+    }
+
+    // Move the last node into the gap
+    auto pLast = m_nodes.back();
+    m_nodes[slot.packedIndex] = pLast;
+    m_slots[pLast->GetIndex()].packedIndex = slot.packedIndex;
+    m_nodes.pop_back();
+
+    // Same again for its type bucket
+    auto& typeNodes = m_nodesByType[pNode->GetType().hash()];
+    auto pLastOfType = typeNodes.back();
+    typeNodes[slot.typeIndex] = pLastOfType;
+    m_slots[pLastOfType->GetIndex()].typeIndex = slot.typeIndex;
+    typeNodes.pop_back();
+
+    // Any handles to this node are now stale
+    slot.pNode = nullptr;
+    slot.generation = slot.generation == NodeHandle::MaxGeneration ? 1 : slot.generation + 1;
+
+    m_displayNodes.Reset(index);
+    m_outputNodes.Reset(index);
     m_mapIdToNode.erase(pNode->GetId());
+    m_freeNodeIndices.push_back(index);
 
-    delete pNode;
+    m_arena.Delete(pNode);
 
     PostModify();
 }
@@ -43,11 +86,14 @@ void Graph::Clear()
 {
     GRAPH_MODIFY(*this);
 
-    while (!nodes.empty())
+    while (!m_nodes.empty())
     {
-        DestroyNode(*nodes.begin());
+        DestroyNode(m_nodes.back());
     }
 
+    // Everything is gone, so hand the blocks back in one go
+    m_arena.Reset();
+
     currentGeneration = 1;
 }
 
@@ -86,71 +132,605 @@ void Graph::Visit(Node& node, PinDir dir, ParameterType type, std::function<bool
     }
 }
 
-void Graph::Compute(const std::set<Node*>& outNodes, int64_t numTicks)
+void Graph::AddNode(Node* pNode)
 {
-    PROFILE_SCOPE(Graph_Compute);
+    auto index = AllocateNodeIndex();
+    pNode->m_index = index;
 
-    currentGeneration++;
+    if (m_slots.size() <= index)
+    {
+        m_slots.resize(index + 1);
+    }
+    m_slots[index].pNode = pNode;
+    m_slots[index].packedIndex = uint32_t(m_nodes.size());
+    m_nodes.push_back(pNode);
+
+    auto& typeNodes = m_nodesByType[pNode->GetType().hash()];
+    m_slots[index].typeIndex = uint32_t(typeNodes.size());
+    typeNodes.push_back(pNode);
+
+    m_displayNodes.Set(index);
+    m_mapIdToNode[pNode->GetId()] = pNode;
+    m_changes.addedNodes.push_back(GetHandle(*pNode));
+
+    // Unconnected, so it can go anywhere; the end is simplest
+    if (m_nodeOrder.size() <= pNode->GetIndex())
+    {
+        m_nodeOrder.resize(pNode->GetIndex() + 1);
+    }
+    m_nodeOrder[pNode->GetIndex()] = m_nextNodeOrder++;
+}
+
+void Graph::RecordConnection(Pin& output, Pin& input)
+{
+    GraphChangeSet::Connection made{ GetHandle(output.GetOwnerNode()), GetHandle(input.GetOwnerNode()), &output, &input };
+
+    // Putting back one broken in this edit is no change at all
+    if (!EraseConnection(m_changes.removedConnections, made))
+    {
+        m_changes.addedConnections.push_back(made);
+    }
+}
+
+void Graph::RecordDisconnection(Pin& output, Pin& input)
+{
+    GraphChangeSet::Connection broken{ GetHandle(output.GetOwnerNode()), GetHandle(input.GetOwnerNode()), &output, &input };
+
+    // A connection made in this edit just drops out
+    if (!EraseConnection(m_changes.addedConnections, broken))
+    {
+        m_changes.removedConnections.push_back(broken);
+    }
+}
 
-    using fnEval = std::function<void(Node * pEvalNode)>;
-    fnEval eval = [&](Node* pEvalNode) {
-        // Don't re-evaluate
-        if (pEvalNode->GetGeneration() == currentGeneration)
-            return;
+bool Graph::EraseConnection(std::vector<GraphChangeSet::Connection>& connections, const GraphChangeSet::Connection& connection)
+{
+    auto itr = std::find_if(connections.begin(), connections.end(), [&](const GraphChangeSet::Connection& other) {
+        return other.pOutput == connection.pOutput && other.pInput == connection.pInput && other.source == connection.source && other.target == connection.target;
+    });
+    if (itr == connections.end())
+    {
+        return false;
+    }
+    connections.erase(itr);
+    return true;
+}
 
-        std::set<Node*> sourceEvalNodes;
+void Graph::EmitChanges()
+{
+    auto isLive = [&](NodeHandle handle) { return GetNode(handle) != nullptr; };
 
-        for (auto& pin : pEvalNode->GetInputs())
+    // Drop nodes that came and went in the same edit, along with their connections
+    // Local, as a handler may edit the graph and emit again
+    GraphChangeSet changes;
+    for (auto& handle : m_changes.addedNodes)
+    {
+        if (isLive(handle))
+        {
+            changes.addedNodes.push_back(handle);
+        }
+    }
+
+    for (auto& removed : m_changes.removedNodes)
+    {
+        if (std::find(m_changes.addedNodes.begin(), m_changes.addedNodes.end(), removed.handle) == m_changes.addedNodes.end())
+        {
+            changes.removedNodes.push_back(removed);
+        }
+    }
+
+    for (auto& connection : m_changes.addedConnections)
+    {
+        if (isLive(connection.source) && isLive(connection.target))
         {
-            if (pin->GetDirection() == PinDir::Input && (pin->GetType() == ParameterType::FlowData))
+            changes.addedConnections.push_back(connection);
+        }
+    }
+    changes.removedConnections = m_changes.removedConnections;
+    m_changes.Clear();
+
+    sigChanged(this, changes);
+}
+
+const std::vector<Node*>* Graph::GetNodesOfType(ctti::type_id_t type) const
+{
+    auto itr = m_nodesByType.find(type.hash());
+    return itr == m_nodesByType.end() ? nullptr : &itr->second;
+}
+
+NodeHandle Graph::GetHandle(const Node& node) const
+{
+    return NodeHandle(node.GetIndex(), m_slots[node.GetIndex()].generation);
+}
+
+bool Graph::IsDisplayNode(const Node& node) const
+{
+    return m_displayNodes.Test(node.GetIndex());
+}
+
+bool Graph::IsOutputNode(const Node& node) const
+{
+    return m_outputNodes.Test(node.GetIndex());
+}
+
+std::vector<Node*> Graph::GatherNodes(const DenseBitset& mask) const
+{
+    std::vector<Node*> found;
+    mask.ForEach([&](size_t index) {
+        found.push_back(m_slots[index].pNode);
+    });
+    return found;
+}
+
+void Graph::SetNodeMask(DenseBitset& mask, const std::set<Node*>& nodes)
+{
+    mask.ClearAll();
+    for (auto& pNode : nodes)
+    {
+        assert(&pNode->GetGraph() == this);
+        mask.Set(pNode->GetIndex());
+    }
+}
+
+uint32_t Graph::GetTopologicalOrder(const Node& node) const
+{
+    return m_nodeOrder[node.GetIndex()];
+}
+
+// Pearce-Kelly dynamic topological sort: only the nodes between the two ends of the new
+// connection in the current order are searched and shuffled.
+void Graph::OrderConnection(Node& source, Node& target)
+{
+    if (&source == &target)
+    {
+        throw std::invalid_argument("Cannot connect to the same node");
+    }
+
+    auto lower = m_nodeOrder[target.GetIndex()];
+    auto upper = m_nodeOrder[source.GetIndex()];
+    if (upper < lower)
+    {
+        // Already in order
+        return;
+    }
+
+    m_orderVisited.Resize(m_nextNodeIndex);
+    m_orderVisited.ClearAll();
+    m_orderForward.clear();
+    m_orderBackward.clear();
+
+    // Everything downstream of the target that is currently placed before the source
+    m_orderStack.clear();
+    m_orderStack.push_back(&target);
+    m_orderVisited.Set(target.GetIndex());
+    while (!m_orderStack.empty())
+    {
+        auto pNode = m_orderStack.back();
+        m_orderStack.pop_back();
+        m_orderForward.push_back(pNode);
+
+        for (auto& pOut : pNode->GetOutputs())
+        {
+            for (auto& pTargetPin : pOut->GetTargets())
             {
-                auto pSource = pin->GetSource();
-                if (pSource != nullptr && pSource->GetOwnerNode().GetGeneration() != currentGeneration)
+                auto& next = pTargetPin->GetOwnerNode();
+                if (&next == &source)
                 {
-                    auto pSourceNode = &pSource->GetOwnerNode();
-                    sourceEvalNodes.insert(pSourceNode);
+                    throw std::invalid_argument("Connection would create a cycle");
+                }
+
+                if (m_nodeOrder[next.GetIndex()] < upper && !m_orderVisited.TestAndSet(next.GetIndex()))
+                {
+                    m_orderStack.push_back(&next);
                 }
             }
         }
+    }
+
+    // Everything upstream of the source that is currently placed after the target
+    m_orderStack.push_back(&source);
+    m_orderVisited.Set(source.GetIndex());
+    while (!m_orderStack.empty())
+    {
+        auto pNode = m_orderStack.back();
+        m_orderStack.pop_back();
+        m_orderBackward.push_back(pNode);
+
+        for (auto& pIn : pNode->GetInputs())
+        {
+            if (pIn->GetSource())
+            {
+                auto& next = pIn->GetSource()->GetOwnerNode();
+                if (m_nodeOrder[next.GetIndex()] > lower && !m_orderVisited.TestAndSet(next.GetIndex()))
+                {
+                    m_orderStack.push_back(&next);
+                }
+            }
+        }
+    }
+
+    // The upstream set goes first, then the downstream set, reusing the same order slots
+    auto byOrder = [&](Node* pLeft, Node* pRight) {
+        return m_nodeOrder[pLeft->GetIndex()] < m_nodeOrder[pRight->GetIndex()];
+    };
+    std::sort(m_orderBackward.begin(), m_orderBackward.end(), byOrder);
+    std::sort(m_orderForward.begin(), m_orderForward.end(), byOrder);
+
+    m_orderPool.clear();
+    for (auto& pNode : m_orderBackward)
+    {
+        m_orderPool.push_back(m_nodeOrder[pNode->GetIndex()]);
+    }
+    for (auto& pNode : m_orderForward)
+    {
+        m_orderPool.push_back(m_nodeOrder[pNode->GetIndex()]);
+    }
+    std::sort(m_orderPool.begin(), m_orderPool.end());
+
+    size_t slot = 0;
+    for (auto& pNode : m_orderBackward)
+    {
+        m_nodeOrder[pNode->GetIndex()] = m_orderPool[slot++];
+    }
+    for (auto& pNode : m_orderForward)
+    {
+        m_nodeOrder[pNode->GetIndex()] = m_orderPool[slot++];
+    }
+}
+
+uint32_t Graph::AllocateNodeIndex()
+{
+    if (!m_freeNodeIndices.empty())
+    {
+        auto index = m_freeNodeIndices.back();
+        m_freeNodeIndices.pop_back();
+        return index;
+    }
+    if (m_nextNodeIndex > NodeHandle::IndexMask)
+    {
+        throw std::length_error("Too many nodes in graph");
+    }
+    return m_nextNodeIndex++;
+}
+
+void Graph::SetComputeMode(ComputeMode mode, uint32_t numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    if (mode != m_computeMode || numThreads != m_numThreads)
+    {
+        m_spThreadPool.reset();
+        m_spScheduler.reset();
+    }
+
+    m_computeMode = mode;
+    m_numThreads = mode == ComputeMode::Serial ? 0 : numThreads;
+    if (m_numThreads == 0)
+    {
+        return;
+    }
 
-        // Walk up to the parents, evaluating them
-        for (auto& pSource : sourceEvalNodes)
+    if (mode == ComputeMode::Parallel && !m_spThreadPool)
+    {
+        m_spThreadPool = std::make_shared<ThreadPool>(m_numThreads);
+    }
+    else if (mode == ComputeMode::WorkStealing && !m_spScheduler)
+    {
+        m_spScheduler = std::make_shared<WorkStealingScheduler>(m_numThreads);
+        m_fnComputeStep = [this](uint32_t step) {
+            ComputeStep(step, m_computeTicks);
+        };
+    }
+}
+
+bool Graph::InputsChanged(uint32_t stepIndex, const Node& node)
+{
+    if (node.Flags() & NodeFlags::AlwaysCompute)
+    {
+        return true;
+    }
+
+    // Generations only go up, so the sum changes if any of them do
+    uint64_t inputGeneration = 0;
+    bool sourceComputed = false;
+    for (auto& pin : node.GetInputs())
+    {
+        auto pSource = pin->GetSource();
+        if (pSource)
+        {
+            inputGeneration += pSource->GetGeneration();
+
+            // Flow data changes without the pin changing; the source node was computed before us if it changed
+            if (pin->GetType() == ParameterType::FlowData && pSource->GetOwnerNode().GetGeneration() == currentGeneration)
+            {
+                sourceComputed = true;
+            }
+        }
+        else
         {
-            eval(pSource);
+            inputGeneration += pin->GetGeneration();
         }
+    }
 
-        // Portmento updates
-        for (auto& pin : pEvalNode->GetInputs())
+    auto& lastGeneration = m_stepInputGenerations[stepIndex];
+    if (lastGeneration != inputGeneration)
+    {
+        lastGeneration = inputGeneration;
+        return true;
+    }
+    return sourceComputed;
+}
+
+void Graph::ComputeStep(uint32_t stepIndex, int64_t numTicks)
+{
+    auto& node = *m_plan.GetSteps()[stepIndex].pNode;
+
+    // Don't re-evaluate
+    if (node.GetGeneration() == currentGeneration)
+        return;
+
+    // Control pins were lerped by the ramps at the start of the tick
+    if (m_incrementalCompute && !InputsChanged(stepIndex, node))
+    {
+        return;
+    }
+
+    for (auto& pin : node.GetInputs())
+    {
+        if (pin->GetType() == ParameterType::FlowData)
         {
             pin->Update(numTicks);
         }
+    }
 
-        //LOG(DEBUG) << "Computing: " << pEvalNode->GetType().name();
+    //LOG(DEBUG) << "Computing: " << node.GetType().name();
 
-        // Compute the node
-        pEvalNode->Compute();
+    // Compute the node
+    node.Compute();
 
-        // Output portmento
-        for (auto& pin : pEvalNode->GetOutputs())
+    for (auto& pin : node.GetOutputs())
+    {
+        if (pin->GetType() == ParameterType::FlowData)
         {
             pin->Update(numTicks);
         }
+        else
+        {
+            m_parameterRamps.CatchUp(*pin);
+        }
+    }
 
-        // It is now at the current generation
-        pEvalNode->SetGeneration(currentGeneration);
-    };
+    // It is now at the current generation
+    node.SetGeneration(currentGeneration);
+}
 
-    for (auto& pNode : outNodes)
+void Graph::ComputeLevels(int64_t numTicks)
+{
+    for (uint32_t level = 0; level < m_plan.GetNumLevels(); level++)
     {
-        eval(pNode);
-    };
+        auto pBegin = m_plan.GetLevelBegin(level);
+        auto pEnd = m_plan.GetLevelEnd(level);
+        auto count = uint32_t(pEnd - pBegin);
+
+        // Split the level into one batch per worker, plus one for this thread
+        auto numBatches = std::min(count, m_numThreads + 1);
+        auto batchSize = (count + numBatches - 1) / numBatches;
+
+        auto computeBatch = [&, numTicks](const uint32_t* pStart, const uint32_t* pStop) {
+            for (auto pIndex = pStart; pIndex < pStop; pIndex++)
+            {
+                ComputeStep(*pIndex, numTicks);
+            }
+        };
+
+        m_computeTasks.clear();
+        for (uint32_t batch = 1; batch < numBatches; batch++)
+        {
+            auto pStart = pBegin + std::min(count, batch * batchSize);
+            auto pStop = pBegin + std::min(count, (batch + 1) * batchSize);
+            if (pStart < pStop)
+            {
+                m_computeTasks.push_back(m_spThreadPool->enqueue(computeBatch, pStart, pStop));
+            }
+        }
+
+        // If our batch throws, the workers are still using the nodes; let them finish first
+        std::exception_ptr pError;
+        try
+        {
+            computeBatch(pBegin, pBegin + std::min(count, batchSize));
+        }
+        catch (...)
+        {
+            pError = std::current_exception();
+        }
+
+        // The next level reads what this one wrote
+        for (auto& task : m_computeTasks)
+        {
+            task.wait();
+        }
+        if (pError)
+        {
+            std::rethrow_exception(pError);
+        }
+        for (auto& task : m_computeTasks)
+        {
+            task.get();
+        }
+    }
+}
+
+void Graph::Compute(const std::set<Node*>& outNodes, int64_t numTicks)
+{
+    PROFILE_SCOPE(Graph_Compute);
+
+    // Only rebuild the order if the graph changed or we are asked for different outputs
+    if (m_planDirty || !m_plan.Matches(outNodes))
+    {
+        m_plan.Build(*this, outNodes);
+        m_planDirty = false;
+
+        // Everything in a new plan computes at least once
+        m_stepInputGenerations.assign(m_plan.GetSteps().size(), std::numeric_limits<uint64_t>::max());
+    }
+
+    currentGeneration++;
+
+    // Portmento for every control pin, in one pass; then the UI's changes, which start from here
+    m_parameterRamps.Advance(numTicks);
+    ApplyParameterChanges();
+
+    // Nodes on workers hand lerps they start over to the ramps, to be applied once they are done
+    if (m_computeMode == ComputeMode::Parallel && m_spThreadPool)
+    {
+        ParameterRamps::WorkerScope rampScope(m_parameterRamps);
+        ComputeLevels(numTicks);
+        return;
+    }
+
+    if (m_computeMode == ComputeMode::WorkStealing && m_spScheduler)
+    {
+        ParameterRamps::WorkerScope rampScope(m_parameterRamps);
+        m_computeTicks = numTicks;
+        m_spScheduler->Run(m_plan, m_fnComputeStep);
+        return;
+    }
+
+    // Skipped nodes keep their last output, so they can't share buffers
+    if (m_flowBufferPooling && !m_incrementalCompute)
+    {
+        FlowBufferPool::Scope scope(m_flowBufferPool);
+        for (uint32_t step = 0; step < uint32_t(m_plan.GetSteps().size()); step++)
+        {
+            ComputeStep(step, numTicks);
+            ReleaseFlowOutputs(step);
+        }
+        return;
+    }
+
+    for (uint32_t step = 0; step < uint32_t(m_plan.GetSteps().size()); step++)
+    {
+        ComputeStep(step, numTicks);
+    }
+}
+
+void Graph::QueueParameterChange(Pin& pin, const ParameterValue& value, uint32_t sampleOffset)
+{
+    // Strings are shared and counted, so the compute thread would free them when it reuses a batch slot
+    switch (value.type)
+    {
+    case ParameterType::Float:
+    case ParameterType::Double:
+    case ParameterType::Int64:
+    case ParameterType::Bool:
+        break;
+    default:
+        throw std::invalid_argument("Only numbers can be queued as parameter changes");
+    }
+
+    ParameterChange change;
+    change.node = GetHandle(pin.GetOwnerNode());
+    change.pPin = &pin;
+    change.value = value;
+    change.sampleOffset = sampleOffset;
+    m_parameterChanges.enqueue(std::move(change));
+}
+
+void Graph::QueueParameterChangeNormalized(Pin& pin, double value, uint32_t sampleOffset)
+{
+    ParameterChange change;
+    change.node = GetHandle(pin.GetOwnerNode());
+    change.pPin = &pin;
+    change.value = ParameterValue(value);
+    change.normalized = true;
+    change.sampleOffset = sampleOffset;
+    m_parameterChanges.enqueue(std::move(change));
+}
+
+void Graph::ApplyParameterChanges()
+{
+    // In batches, so there is no allocation here; the queue only holds numbers, so there is no freeing either
+    const size_t BatchSize = 64;
+    ParameterChange changes[BatchSize];
+    size_t count;
+    while ((count = m_parameterChanges.try_dequeue_bulk(changes, BatchSize)) != 0)
+    {
+        for (size_t index = 0; index < count; index++)
+        {
+            auto& change = changes[index];
+            if (!GetNode(change.node))
+            {
+                continue;
+            }
+
+            auto& pin = *change.pPin;
+            if (change.normalized)
+            {
+                pin.SetFromNormalized(change.value.dVal);
+            }
+            else
+            {
+                switch (change.value.type)
+                {
+                case ParameterType::Float:
+                    pin.SetFrom(change.value.fVal);
+                    break;
+                case ParameterType::Double:
+                    pin.SetFrom(change.value.dVal);
+                    break;
+                case ParameterType::Int64:
+                    pin.SetFrom(change.value.iVal);
+                    break;
+                case ParameterType::Bool:
+                    pin.SetFrom(change.value.bVal);
+                    break;
+                default:
+                    assert(!"QueueParameterChange only takes numbers");
+                    break;
+                }
+            }
+
+            if (change.sampleOffset != 0)
+            {
+                m_parameterRamps.Delay(pin, change.sampleOffset);
+            }
+        }
+    }
+}
+
+void Graph::ReleaseFlowOutputs(uint32_t stepIndex)
+{
+    auto& steps = m_plan.GetSteps();
+    for (auto pRelease = m_plan.GetReleasesBegin(stepIndex); pRelease != m_plan.GetReleasesEnd(stepIndex); pRelease++)
+    {
+        for (auto& pOutput : steps[*pRelease].pNode->GetFlowOutputs())
+        {
+            if (auto pData = pOutput->GetFlowData())
+            {
+                pData->ReleaseChannels(m_flowBufferPool);
+            }
+        }
+    }
+}
+
+void Graph::SetFlowBufferPooling(bool pooling)
+{
+    m_flowBufferPooling = pooling;
+    if (!pooling)
+    {
+        m_flowBufferPool.Clear();
+    }
 }
 
 std::vector<Pin*> Graph::GetControlSurface() const
 {
     // All pins that have interesting data to display
     std::vector<Pin*> pins;
-    for (auto& pNode : nodes)
+    for (auto& pNode : m_nodes)
     {
         for (auto& in : pNode->GetInputs())
         {
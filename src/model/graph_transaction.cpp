@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+#include "nodegraph/model/graph_transaction.h"
+
+namespace NodeGraph
+{
+
+GraphTransaction::GraphTransaction(Graph& graph)
+    : m_graph(graph)
+{
+    m_graph.PreModify();
+}
+
+GraphTransaction::~GraphTransaction()
+{
+    if (m_open)
+    {
+        Rollback();
+    }
+}
+
+void GraphTransaction::CheckOpen() const
+{
+    if (!m_open)
+    {
+        throw std::invalid_argument("Transaction is already closed");
+    }
+}
+
+Node* GraphTransaction::GetLiveNode(NodeHandle handle) const
+{
+    auto pNode = m_graph.GetNode(handle);
+    if (pNode && std::find(m_destroyed.begin(), m_destroyed.end(), handle) != m_destroyed.end())
+    {
+        throw std::invalid_argument("Node is destroyed in this transaction: " + pNode->GetName());
+    }
+    return pNode;
+}
+
+void GraphTransaction::Connect(Node* pSource, Node* pDest, const std::string& outputName, const std::string& inputName)
+{
+    CheckOpen();
+    if (!pSource || !pDest)
+    {
+        throw std::invalid_argument("Can't connect a null node");
+    }
+
+    Connection connection;
+    connection.source = m_graph.GetHandle(*pSource);
+    connection.dest = m_graph.GetHandle(*pDest);
+    connection.outputName = outputName.empty() ? "Flow" : outputName;
+    connection.inputName = inputName;
+    m_connections.push_back(connection);
+}
+
+void GraphTransaction::Disconnect(Node* pSource, Node* pDest, const std::string& outputName, const std::string& inputName)
+{
+    CheckOpen();
+    if (!pSource || !pDest)
+    {
+        throw std::invalid_argument("Can't disconnect a null node");
+    }
+
+    Connection connection;
+    connection.source = m_graph.GetHandle(*pSource);
+    connection.dest = m_graph.GetHandle(*pDest);
+    connection.outputName = outputName.empty() ? "Flow" : outputName;
+    connection.inputName = inputName;
+    m_disconnections.push_back(connection);
+}
+
+void GraphTransaction::Destroy(Node* pNode)
+{
+    CheckOpen();
+    if (!pNode)
+    {
+        return;
+    }
+
+    auto handle = m_graph.GetHandle(*pNode);
+    if (std::find(m_destroyed.begin(), m_destroyed.end(), handle) == m_destroyed.end())
+    {
+        m_destroyed.push_back(handle);
+    }
+}
+
+void GraphTransaction::Validate()
+{
+    // Inputs freed by disconnections in this transaction
+    std::set<Pin*> freedInputs;
+
+    for (auto& connection : m_disconnections)
+    {
+        auto pSource = GetLiveNode(connection.source);
+        auto pDest = GetLiveNode(connection.dest);
+        if (!pSource || !pDest)
+        {
+            throw std::invalid_argument("Can't disconnect a node that is no longer in the graph");
+        }
+
+        connection.pOutput = pSource->GetOutput(connection.outputName);
+        if (!connection.pOutput)
+        {
+            throw std::invalid_argument("Can't find output pin: " + connection.outputName);
+        }
+
+        if (!connection.inputName.empty())
+        {
+            connection.pInput = pDest->GetInput(connection.inputName);
+        }
+        else
+        {
+            for (auto& pInput : pDest->GetInputs())
+            {
+                if (pInput->GetSource() == connection.pOutput)
+                {
+                    connection.pInput = pInput;
+                    break;
+                }
+            }
+        }
+
+        if (!connection.pInput || connection.pInput->GetSource() != connection.pOutput || !freedInputs.insert(connection.pInput).second)
+        {
+            throw std::invalid_argument("Pins aren't connected: " + connection.outputName);
+        }
+    }
+
+    // Inputs taken by earlier connections in this transaction
+    std::set<Pin*> usedInputs;
+
+    for (auto& connection : m_connections)
+    {
+        auto pSource = GetLiveNode(connection.source);
+        auto pDest = GetLiveNode(connection.dest);
+        if (!pSource || !pDest)
+        {
+            throw std::invalid_argument("Can't connect a node that is no longer in the graph");
+        }
+
+        if (pSource == pDest)
+        {
+            throw std::invalid_argument("Cannot connect to the same node");
+        }
+
+        connection.pOutput = pSource->GetOutput(connection.outputName);
+        if (!connection.pOutput)
+        {
+            throw std::invalid_argument("Can't find output pin: " + connection.outputName);
+        }
+
+        // Resolve the input the way ConnectTo will
+        if (!connection.inputName.empty() && connection.inputName != str_AutoGen)
+        {
+            connection.pInput = pDest->GetInput(connection.inputName);
+            if (!connection.pInput)
+            {
+                throw std::invalid_argument("Can't find input pin: " + connection.inputName);
+            }
+        }
+        else
+        {
+            connection.pInput = pDest->GetInput(connection.outputName);
+            if (!connection.pInput && connection.pOutput->GetType() != ParameterType::FlowData)
+            {
+                throw std::invalid_argument("Can only generate inputs of flow data type");
+            }
+        }
+
+        bool taken = connection.pInput && connection.pInput->GetSource() && !freedInputs.count(connection.pInput);
+        if (connection.pInput && (taken || !usedInputs.insert(connection.pInput).second))
+        {
+            throw std::invalid_argument("Can't connect more than one signal to the same input");
+        }
+    }
+
+    for (auto& handle : m_destroyed)
+    {
+        if (!m_graph.GetNode(handle))
+        {
+            throw std::invalid_argument("Can't destroy a node that is no longer in the graph");
+        }
+    }
+}
+
+void GraphTransaction::Commit()
+{
+    CheckOpen();
+
+    try
+    {
+        Validate();
+    }
+    catch (...)
+    {
+        Rollback();
+        throw;
+    }
+
+    for (auto& connection : m_disconnections)
+    {
+        connection.pOutput->RemoveTarget(connection.pInput);
+        connection.pInput->SetSource(nullptr);
+        m_graph.RecordDisconnection(*connection.pOutput, *connection.pInput);
+    }
+
+    // Only a cycle can fail from here, and ConnectTo checks that before it changes anything
+    size_t applied = 0;
+    try
+    {
+        for (; applied < m_connections.size(); applied++)
+        {
+            auto& connection = m_connections[applied];
+            auto pDest = m_graph.GetNode(connection.dest);
+            m_graph.GetNode(connection.source)->ConnectTo(pDest, connection.outputName, connection.inputName);
+            if (!connection.pInput)
+            {
+                connection.pInput = pDest->GetInputs().back();
+            }
+        }
+    }
+    catch (...)
+    {
+        for (size_t index = 0; index < applied; index++)
+        {
+            auto& connection = m_connections[index];
+            connection.pOutput->RemoveTarget(connection.pInput);
+            connection.pInput->SetSource(nullptr);
+            m_graph.RecordDisconnection(*connection.pOutput, *connection.pInput);
+        }
+        for (auto& connection : m_disconnections)
+        {
+            connection.pOutput->AddTarget(connection.pInput);
+            connection.pInput->SetSource(connection.pOutput);
+            m_graph.RecordConnection(*connection.pOutput, *connection.pInput);
+        }
+        Rollback();
+        throw;
+    }
+
+    for (auto& handle : m_destroyed)
+    {
+        m_graph.DestroyNode(m_graph.GetNode(handle));
+    }
+
+    Close();
+}
+
+void GraphTransaction::Rollback()
+{
+    CheckOpen();
+
+    for (auto itr = m_created.rbegin(); itr != m_created.rend(); itr++)
+    {
+        m_graph.DestroyNode(m_graph.GetNode(*itr));
+    }
+
+    Close();
+}
+
+void GraphTransaction::Close()
+{
+    m_created.clear();
+    m_connections.clear();
+    m_disconnections.clear();
+    m_destroyed.clear();
+    m_open = false;
+
+    // Emits the change set
+    m_graph.PostModify();
+}
+
+} // namespace NodeGraph
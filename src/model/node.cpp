@@ -29,13 +29,18 @@ Node::~Node()
 
     sigDestroy(this);
 
+    auto& arena = m_graph.GetArena();
     for (auto& input : m_inputs)
     {
-        delete input;
+        arena.Delete(input);
     }
     for (auto& output : m_outputs)
     {
-        delete output;
+        arena.Delete(output);
+    }
+    for (auto& pData : m_flowData)
+    {
+        arena.Delete(pData);
     }
 
     ClearDecorators();
@@ -61,16 +66,23 @@ void Node::ClearDecorators()
     // For now, decorators don't modify the graph.
     // We will implement draw from nodes later...
     //GRAPH_MODIFY(m_graph);
+    auto& arena = m_graph.GetArena();
     for (auto& decorator : m_decorators)
     {
-        delete decorator;
+        if (arena.Owns(decorator))
+        {
+            arena.Delete(decorator);
+        }
+        else
+        {
+            delete decorator;
+        }
     }
     m_decorators.clear();
 }
 
 void Node::ConnectIndexTo(Node* pDest, uint32_t outputIndex, int32_t inputIndex)
 {
-    GRAPH_MODIFY(m_graph);
     if (m_outputs.size() <= (size_t)outputIndex)
     {
         throw std::invalid_argument("outputIndex too big");
@@ -98,29 +110,30 @@ void Node::ConnectIndexTo(Node* pDest, uint32_t outputIndex, int32_t inputIndex)
             throw std::invalid_argument("Types don't match on pins");
         }
     }
-    else
+    else if (m_outputs[outputIndex]->GetType() != ParameterType::FlowData)
     {
-        if (m_outputs[outputIndex]->GetType() == ParameterType::FlowData)
-        {
-            int size = (int)pDest->GetFlowInputs().size();
-            pDest->AddInputFlow(std::string("Flow_") + std::to_string(size), (IFlowData*)new FlowData(0, ParameterType::Float));
-            inputIndex = size;
-        }
-        else
-        {
-            throw std::invalid_argument("Can only generate inputs of flow data type");
-        }
+        throw std::invalid_argument("Can only generate inputs of flow data type");
+    }
+
+    // The pins are good, so only a loop can stop it now; that throws before anything changes
+    GRAPH_MODIFY(m_graph);
+    m_graph.OrderConnection(*this, *pDest);
+
+    if (inputIndex < 0)
+    {
+        int size = (int)pDest->GetFlowInputs().size();
+        pDest->AddInputFlow(std::string("Flow_") + std::to_string(size), (IFlowData*)new FlowData(0, ParameterType::Float));
+        inputIndex = size;
     }
 
     // Connect it up
     m_outputs[outputIndex]->AddTarget(pDest->GetInputs()[inputIndex]);
     pDest->GetInputs()[inputIndex]->SetSource(m_outputs[outputIndex]);
+    m_graph.RecordConnection(*m_outputs[outputIndex], *pDest->GetInputs()[inputIndex]);
 }
 
 void Node::ConnectTo(Node* pDest, const std::string& outputName, const std::string& inName)
 {
-    GRAPH_MODIFY(m_graph);
-
     std::string searchOutputName;
     if (!outputName.empty())
     {
@@ -131,33 +144,22 @@ void Node::ConnectTo(Node* pDest, const std::string& outputName, const std::stri
         searchOutputName = "Flow";
     }
 
-    Pin* pOut = nullptr;
-    for (auto& pPin : m_outputs)
+    Pin* pOut = GetOutput(searchOutputName);
+    if (pOut == nullptr)
     {
-        if (pPin->GetName() == searchOutputName)
-        {
-            pOut = pPin;
-            break;
-        }
+        throw std::invalid_argument("Can't find output pin: " + searchOutputName);
     }
 
-    if (pOut == nullptr)
+    if (pDest == this)
     {
-        throw std::invalid_argument("Can't find output pin: " + searchOutputName);
+        throw std::invalid_argument("Cannot connect to the same node");
     }
 
     Pin* pIn = nullptr;
     if (!inName.empty() && inName != str_AutoGen)
     {
         // Provided a name for the input, find it
-        for (auto& pPin : pDest->GetInputs())
-        {
-            if (pPin->GetName() == inName)
-            {
-                pIn = pPin;
-                break;
-            }
-        }
+        pIn = pDest->GetInput(inName);
         if (pIn == nullptr)
         {
             throw std::invalid_argument("Can't find input pin: " + inName);
@@ -165,50 +167,39 @@ void Node::ConnectTo(Node* pDest, const std::string& outputName, const std::stri
     }
     else
     {
-        // Try to match output name
-        for (auto& pPin : pDest->GetInputs())
+        // Try to match output name; otherwise a flow input is generated once the connection is known to be good
+        pIn = pDest->GetInput(searchOutputName);
+        if (!pIn && pOut->GetType() != ParameterType::FlowData)
         {
-            if (pPin->GetName() == searchOutputName)
-            {
-                pIn = pPin;
-                break;
-            }
-        }
-
-        // Auto gen or nothing
-        if (!pIn)
-        {
-            // Auto connecting flow
-            if (pOut->GetType() == ParameterType::FlowData)
-            {
-                int size = (int)pDest->GetFlowInputs().size();
-                pIn = pDest->AddInputFlow(std::string("Flow_") + std::to_string(size), (IFlowData*)new FlowData(0, ParameterType::Float));
-            }
-            else
-            {
-                throw std::invalid_argument("Can only generate inputs of flow data type");
-            }
+            throw std::invalid_argument("Can only generate inputs of flow data type");
         }
     }
 
-    if (pDest == this)
+    if (pIn && pIn->GetSource() != nullptr)
     {
-        throw std::invalid_argument("Cannot connect to the same node");
+        throw std::invalid_argument("Can't connect more than one signal to the same input");
     }
 
-    if (pIn->GetSource() != nullptr)
+    if (pOut->GetSource() != nullptr)
     {
         throw std::invalid_argument("Can't connect more than one signal to the same input");
     }
 
-    if (pOut->GetSource() != nullptr)
+    // The pins are good, so only a loop can stop it now; that throws before anything changes
+    GRAPH_MODIFY(m_graph);
+    m_graph.OrderConnection(*this, *pDest);
+
+    // Auto connecting flow
+    if (!pIn)
     {
-        throw std::invalid_argument("Can't connect more than one signal to the same input");
+        int size = (int)pDest->GetFlowInputs().size();
+        pIn = pDest->AddInputFlow(std::string("Flow_") + std::to_string(size), (IFlowData*)new FlowData(0, ParameterType::Float));
     }
 
     // Connect it up
     pOut->AddTarget(pIn);
     pIn->SetSource(pOut);
+    m_graph.RecordConnection(*pOut, *pIn);
 }
 
 void Node::Compute()
@@ -216,47 +207,88 @@ void Node::Compute()
     /* Default compute; do nothing */
 }
 
-// TODO: Optimize with a map later
-Pin* Node::GetPin(const std::string& name) const
+uint32_t Node::HashPinName(const std::string& name)
+{
+    return MUtils::murmur_hash(name.c_str(), int(name.length()), 0);
+}
+
+Pin* Node::IndexPin(Pin* pPin)
+{
+    // Keep the first pin of a name, as the old linear search did
+    auto& index = pPin->GetDirection() == PinDir::Input ? m_inputIndex : m_outputIndex;
+    index.emplace(HashPinName(pPin->GetName()), pPin);
+    return pPin;
+}
+
+Pin* Node::FindPin(const std::unordered_map<uint32_t, Pin*>& index, const std::vector<Pin*>& pins, uint32_t hash, const std::string& name) const
 {
-    for (auto& p : m_inputs)
+    auto itr = index.find(hash);
+    if (itr == index.end())
     {
-        if (p->GetName() == name)
-        {
-            return p;
-        }
+        return nullptr;
+    }
+
+    if (itr->second->GetName() == name)
+    {
+        return itr->second;
     }
 
-    for (auto& p : m_outputs)
+    // Two names with the same hash; only the first one is indexed
+    for (auto& pPin : pins)
     {
-        if (p->GetName() == name)
+        if (pPin->GetName() == name)
         {
-            return p;
+            return pPin;
         }
     }
     return nullptr;
 }
+
+Pin* Node::GetInput(const std::string& name) const
+{
+    return FindPin(m_inputIndex, m_inputs, HashPinName(name), name);
+}
+
+Pin* Node::GetOutput(const std::string& name) const
+{
+    return FindPin(m_outputIndex, m_outputs, HashPinName(name), name);
+}
+
+Pin* Node::GetPin(const std::string& name) const
+{
+    auto pPin = GetInput(name);
+    return pPin ? pPin : GetOutput(name);
+}
+
+Pin* Node::GetPinById(const MUtils::StringId& id) const
+{
+    // Another name can have the same id, so the name is still checked
+    auto name = id.ToString();
+    auto pPin = FindPin(m_inputIndex, m_inputs, id.id, name);
+    return pPin ? pPin : FindPin(m_outputIndex, m_outputs, id.id, name);
+}
+
 Pin* Node::AddInputFlow(const std::string& strName, IFlowData* val, const ParameterAttributes& attrib)
 {
     GRAPH_MODIFY(m_graph);
 
-    auto pPin = new Pin(*this, PinDir::Input, strName, val, attrib);
+    auto pPin = m_graph.GetArena().New<Pin>(*this, PinDir::Input, strName, val, attrib);
     m_inputs.push_back(pPin);
     m_flowInputs.push_back(pPin);
     m_flowControlInputs.clear();
 
-    return pPin;
+    return IndexPin(pPin);
 }
 
 Pin* Node::AddOutputFlow(const std::string& strName, IFlowData* val, const ParameterAttributes& attrib)
 {
     GRAPH_MODIFY(m_graph);
 
-    auto pPin = new Pin(*this, PinDir::Output, strName, val, attrib);
+    auto pPin = m_graph.GetArena().New<Pin>(*this, PinDir::Output, strName, val, attrib);
     m_outputs.push_back(pPin);
     m_flowOutputs.push_back(pPin);
     m_flowControlOutputs.clear();
-    return pPin;
+    return IndexPin(pPin);
 }
 
 NodeDecorator* Node::AddDecorator(NodeDecorator* decorator)
@@ -269,6 +301,21 @@ NodeDecorator* Node::AddDecorator(NodeDecorator* decorator)
     return decorator;
 }
 
+NodeDecorator* Node::AddDecorator(DecoratorType type, const std::string& name)
+{
+    return AddDecorator(m_graph.GetArena().New<NodeDecorator>(type, name));
+}
+
+void* Node::AllocatePin()
+{
+    return m_graph.GetArena().Allocate(sizeof(Pin), alignof(Pin));
+}
+
+void* Node::AllocateFlowData(size_t size, size_t align)
+{
+    return m_graph.GetArena().Allocate(size, align);
+}
+
 const std::vector<NodeDecorator*>& Node::GetDecorators() const
 {
     return m_decorators;
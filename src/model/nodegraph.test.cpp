@@ -1,6 +1,12 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <catch2/catch.hpp>
 
+#include "nodegraph/model/automation.h"
 #include "nodegraph/model/graph.h"
+#include "nodegraph/model/graph_transaction.h"
 #include "nodegraph/view/layout.h"
 #include "nodegraph/view/graphview.h"
 
@@ -140,3 +146,1251 @@ SCENARIO("NodeGraph clears correctly", "[NodeGraph]")
 
     }
 }
+
+// Passes flow through, recording the order it was computed in
+class FlowTestNode : public Node
+{
+public:
+    DECLARE_NODE(FlowTestNode, flowtest);
+
+    FlowTestNode(Graph& m_graph, std::vector<Node*>* pOrder = nullptr)
+        : Node(m_graph, "Flow")
+        , m_pOrder(pOrder)
+    {
+        pOutput = AddOutputFlow("Flow", new FlowData(FlowType_Data, ParameterType::Float));
+        pGain = AddInput("Gain", 1.0f);
+    }
+
+    virtual void Compute() override
+    {
+        computeCount++;
+        if (m_pOrder)
+        {
+            m_pOrder->push_back(this);
+        }
+    }
+
+    Pin* pOutput = nullptr;
+    Pin* pGain = nullptr;
+    uint32_t computeCount = 0;
+    std::vector<Node*>* m_pOrder;
+};
+
+TEST_CASE("Compute order", "[Compute]")
+{
+    Graph g;
+    std::vector<Node*> order;
+
+    // A diamond: top feeds left and right, which both feed bottom
+    auto pTop = g.CreateNode<FlowTestNode>(&order);
+    auto pLeft = g.CreateNode<FlowTestNode>(&order);
+    auto pRight = g.CreateNode<FlowTestNode>(&order);
+    auto pBottom = g.CreateNode<FlowTestNode>(&order);
+    pTop->ConnectTo(pLeft);
+    pTop->ConnectTo(pRight);
+    pLeft->ConnectTo(pBottom);
+    pRight->ConnectTo(pBottom);
+
+    g.Compute(std::set<Node*>{ pBottom }, 0);
+
+    // Every node once, sources first
+    REQUIRE(order.size() == 4);
+    REQUIRE(order.front() == pTop);
+    REQUIRE(order.back() == pBottom);
+
+    SECTION("Plan is reused and rebuilt on modify")
+    {
+        order.clear();
+        g.Compute(std::set<Node*>{ pBottom }, 0);
+        REQUIRE(order.size() == 4);
+
+        auto pExtra = g.CreateNode<FlowTestNode>(&order);
+        pExtra->ConnectTo(pTop);
+
+        order.clear();
+        g.Compute(std::set<Node*>{ pBottom }, 0);
+        REQUIRE(order.size() == 5);
+        REQUIRE(order.front() == pExtra);
+    }
+}
+
+// Takes a while and then throws, so other workers are still busy when one of them throws
+class ThrowTestNode : public Node
+{
+public:
+    DECLARE_NODE(ThrowTestNode, throwtest);
+
+    ThrowTestNode(Graph& m_graph, std::atomic<uint32_t>& finished)
+        : Node(m_graph, "Throw")
+        , m_finished(finished)
+    {
+        AddOutputFlow("Flow", new FlowData(FlowType_Data, ParameterType::Float));
+    }
+
+    virtual void Compute() override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        m_finished++;
+        throw std::runtime_error("Compute failed");
+    }
+
+    std::atomic<uint32_t>& m_finished;
+};
+
+// Starts a lerp on its own pin while it computes
+class SetterTestNode : public Node
+{
+public:
+    DECLARE_NODE(SetterTestNode, settertest);
+
+    explicit SetterTestNode(Graph& m_graph)
+        : Node(m_graph, "Setter")
+    {
+        AddOutputFlow("Flow", new FlowData(FlowType_Data, ParameterType::Float));
+        pTarget = AddInput("Target", 0.0f);
+        pTarget->SetLerpSamples(4);
+    }
+
+    virtual void Compute() override
+    {
+        pTarget->Set(1.0f);
+    }
+
+    Pin* pTarget = nullptr;
+};
+
+TEST_CASE("Parallel compute", "[Compute]")
+{
+    Graph g;
+    g.SetComputeMode(ComputeMode::Parallel, 3);
+
+    // Many chains feeding one mixer
+    auto pMix = g.CreateNode<FlowTestNode>();
+    std::vector<FlowTestNode*> nodes;
+    for (int chain = 0; chain < 8; chain++)
+    {
+        auto pVoice = g.CreateNode<FlowTestNode>();
+        auto pEffect = g.CreateNode<FlowTestNode>();
+        pVoice->ConnectTo(pEffect);
+        pEffect->ConnectTo(pMix);
+        nodes.push_back(pVoice);
+        nodes.push_back(pEffect);
+    }
+    nodes.push_back(pMix);
+
+    g.Compute(std::set<Node*>{ pMix }, 0);
+    g.Compute(std::set<Node*>{ pMix }, 0);
+
+    // Each node computed exactly once per tick
+    for (auto& pNode : nodes)
+    {
+        REQUIRE(pNode->computeCount == 2);
+    }
+
+    SECTION("A throw waits for the other batches")
+    {
+        std::atomic<uint32_t> finished = 0;
+        std::set<Node*> outputs;
+        for (int count = 0; count < 16; count++)
+        {
+            outputs.insert(g.CreateNode<ThrowTestNode>(finished));
+        }
+        REQUIRE_THROWS_WITH(g.Compute(outputs, 0), "Compute failed");
+
+        // One level, one node per batch ahead of the throw
+        REQUIRE(finished == 4);
+    }
+
+    SECTION("Lerps started on workers are handed over")
+    {
+        auto pSetter = g.CreateNode<SetterTestNode>();
+        g.Compute(std::set<Node*>{ pSetter }, 0);
+        REQUIRE(pSetter->pTarget->IsRamping());
+        REQUIRE(g.GetParameterRamps().GetNumRamps() == 1);
+
+        g.Compute(std::set<Node*>{ pSetter }, 2);
+        REQUIRE(pSetter->pTarget->To<float>() == 0.5f);
+    }
+}
+
+TEST_CASE("Work stealing compute", "[Compute]")
+{
+    Graph g;
+    g.SetComputeMode(ComputeMode::WorkStealing, 3);
+
+    // A long chain next to many short ones
+    auto pMix = g.CreateNode<FlowTestNode>();
+    std::vector<FlowTestNode*> nodes{ pMix };
+    FlowTestNode* pPrevious = nullptr;
+    for (int link = 0; link < 32; link++)
+    {
+        auto pLink = g.CreateNode<FlowTestNode>();
+        if (pPrevious)
+        {
+            pPrevious->ConnectTo(pLink);
+        }
+        pPrevious = pLink;
+        nodes.push_back(pLink);
+    }
+    pPrevious->ConnectTo(pMix);
+
+    for (int chain = 0; chain < 16; chain++)
+    {
+        auto pVoice = g.CreateNode<FlowTestNode>();
+        pVoice->ConnectTo(pMix);
+        nodes.push_back(pVoice);
+    }
+
+    for (int tick = 0; tick < 10; tick++)
+    {
+        g.Compute(std::set<Node*>{ pMix }, tick);
+    }
+
+    for (auto& pNode : nodes)
+    {
+        REQUIRE(pNode->computeCount == 10);
+    }
+}
+
+TEST_CASE("Incremental compute", "[Compute]")
+{
+    Graph g;
+    g.SetIncrementalCompute(true);
+
+    auto pTop = g.CreateNode<FlowTestNode>();
+    auto pMiddle = g.CreateNode<FlowTestNode>();
+    auto pBottom = g.CreateNode<FlowTestNode>();
+    auto pOther = g.CreateNode<FlowTestNode>();
+    pTop->ConnectTo(pMiddle);
+    pMiddle->ConnectTo(pBottom);
+    pOther->ConnectTo(pBottom);
+
+    std::set<Node*> outputs{ pBottom };
+    g.Compute(outputs, 0);
+    g.Compute(outputs, 1);
+
+    // Nothing changed after the first tick
+    REQUIRE(pTop->computeCount == 1);
+    REQUIRE(pBottom->computeCount == 1);
+
+    SECTION("A changed input recomputes the node and everything downstream")
+    {
+        pMiddle->pGain->Set(0.5f, true);
+        g.Compute(outputs, 2);
+        REQUIRE(pTop->computeCount == 1);
+        REQUIRE(pMiddle->computeCount == 2);
+        REQUIRE(pBottom->computeCount == 2);
+        REQUIRE(pOther->computeCount == 1);
+    }
+
+    SECTION("Always compute nodes are never skipped")
+    {
+        pTop->SetFlags(pTop->Flags() | NodeFlags::AlwaysCompute);
+        g.Compute(outputs, 2);
+        REQUIRE(pTop->computeCount == 2);
+        REQUIRE(pMiddle->computeCount == 2);
+        REQUIRE(pOther->computeCount == 1);
+    }
+}
+
+TEST_CASE("Visit", "[NodeGraph]")
+{
+    Graph g;
+
+    // A ladder of diamonds; walking every path would be exponential
+    auto pTop = g.CreateNode<FlowTestNode>();
+    auto pPrevious = pTop;
+    for (int rung = 0; rung < 20; rung++)
+    {
+        auto pLeft = g.CreateNode<FlowTestNode>();
+        auto pRight = g.CreateNode<FlowTestNode>();
+        auto pJoin = g.CreateNode<FlowTestNode>();
+        pPrevious->ConnectTo(pLeft);
+        pPrevious->ConnectTo(pRight);
+        pLeft->ConnectTo(pJoin);
+        pRight->ConnectTo(pJoin);
+        pPrevious = pJoin;
+    }
+
+    std::set<Node*> seen;
+    uint32_t visits = 0;
+    g.VisitNodes(*pPrevious, PinDir::Input, ParameterType::FlowData, [&](Node& node) {
+        seen.insert(&node);
+        visits++;
+    });
+    REQUIRE(visits == g.GetNodes().size());
+    REQUIRE(seen.size() == g.GetNodes().size());
+
+    SECTION("Returning false stops the walk")
+    {
+        visits = 0;
+        g.VisitNodes(*pTop, PinDir::Output, ParameterType::None, [&](Node& node) {
+            visits++;
+            return &node == pTop;
+        });
+        REQUIRE(visits == 3);
+    }
+
+    SECTION("Visit walks every path and ignores the return value")
+    {
+        auto pA = g.CreateNode<FlowTestNode>();
+        auto pB = g.CreateNode<FlowTestNode>();
+        auto pC = g.CreateNode<FlowTestNode>();
+        auto pD = g.CreateNode<FlowTestNode>();
+        pA->ConnectTo(pB);
+        pA->ConnectTo(pC);
+        pB->ConnectTo(pD);
+        pC->ConnectTo(pD);
+
+        std::vector<Node*> order;
+        g.Visit(*pA, PinDir::Output, ParameterType::None, [&](Node& node) {
+            order.push_back(&node);
+            return false;
+        });
+        // Once per path: the join comes after each branch
+        REQUIRE(order.size() == 5);
+        REQUIRE(order[0] == pA);
+        REQUIRE(order[2] == pD);
+        REQUIRE(order[4] == pD);
+    }
+}
+
+TEST_CASE("Topological order", "[NodeGraph]")
+{
+    Graph g;
+
+    // Created in reverse, so each connection has to reorder
+    std::vector<FlowTestNode*> chain;
+    for (int link = 0; link < 10; link++)
+    {
+        chain.insert(chain.begin(), g.CreateNode<FlowTestNode>());
+    }
+    for (size_t link = 1; link < chain.size(); link++)
+    {
+        chain[link - 1]->ConnectTo(chain[link]);
+    }
+
+    for (size_t link = 1; link < chain.size(); link++)
+    {
+        REQUIRE(g.GetTopologicalOrder(*chain[link - 1]) < g.GetTopologicalOrder(*chain[link]));
+    }
+
+    SECTION("Cycles are rejected")
+    {
+        REQUIRE_THROWS_WITH(chain.back()->ConnectTo(chain.front()), "Connection would create a cycle");
+
+        // No input was generated for the failed connection
+        REQUIRE(chain.front()->GetFlowInputs().empty());
+    }
+
+    SECTION("Bad pins leave the order alone")
+    {
+        // Ordering these two would need a reorder, but the input is already taken
+        auto pLate = g.CreateNode<FlowTestNode>();
+        auto before = g.GetTopologicalOrder(*pLate);
+        // Shared, as the graph outlives this section and still signals when it is destroyed
+        auto spBeginCount = std::make_shared<uint32_t>(0);
+        g.sigBeginModify.connect([spBeginCount](Graph*) { (*spBeginCount)++; });
+
+        REQUIRE_THROWS_WITH(pLate->ConnectTo(chain[1], "Flow", "Flow_0"), "Can't connect more than one signal to the same input");
+        REQUIRE_THROWS_WITH(pLate->ConnectIndexTo(chain[1], 0, 0), "Types don't match on pins");
+        REQUIRE(g.GetTopologicalOrder(*pLate) == before);
+        REQUIRE(*spBeginCount == 0);
+    }
+}
+
+TEST_CASE("Node handles", "[NodeGraph]")
+{
+    Graph g;
+    auto pFirst = g.CreateNode<FlowTestNode>();
+    auto pSecond = g.CreateNode<FlowTestNode>();
+    auto handle = g.GetHandle(*pFirst);
+
+    REQUIRE(g.GetNode(handle) == pFirst);
+    REQUIRE(g.GetNodeById(pSecond->GetId()) == pSecond);
+    REQUIRE(g.IsDisplayNode(*pFirst));
+
+    g.DestroyNode(pFirst);
+    REQUIRE(g.GetNode(handle) == nullptr);
+    REQUIRE(g.GetNodes().size() == 1);
+
+    // The slot is reused, but the old handle stays stale
+    auto pThird = g.CreateNode<FlowTestNode>();
+    REQUIRE(pThird->GetIndex() == handle.GetIndex());
+    REQUIRE(g.GetNode(handle) == nullptr);
+    REQUIRE(g.GetNode(g.GetHandle(*pThird)) == pThird);
+}
+
+TEST_CASE("Node arena", "[NodeGraph]")
+{
+    Graph g;
+
+    // Pins are made straight after their node, so they sit next to it
+    auto pNode = g.CreateNode<FlowTestNode>();
+    auto pPin = pNode->GetInputs()[0];
+    REQUIRE(g.GetArena().Owns(pNode));
+    REQUIRE(g.GetArena().Owns(pPin));
+    REQUIRE(std::abs((uint8_t*)pPin - (uint8_t*)pNode) < 4096);
+
+    auto pDecorator = pNode->AddDecorator(DecoratorType::Label, "Label");
+    REQUIRE(g.GetArena().Owns(pDecorator));
+    pNode->AddDecorator(new NodeDecorator(DecoratorType::Line));
+
+    // Big and over aligned allocations are made on their own, but still belong to the arena
+    auto pLarge = static_cast<uint8_t*>(g.GetArena().Allocate(5000, 64));
+    auto pAligned = static_cast<uint8_t*>(g.GetArena().Allocate(32, 256));
+    REQUIRE(uintptr_t(pLarge) % 64 == 0);
+    REQUIRE(uintptr_t(pAligned) % 256 == 0);
+    REQUIRE(g.GetArena().Owns(pLarge + 4999));
+    REQUIRE(g.GetArena().Owns(pAligned));
+    REQUIRE_FALSE(g.GetArena().Owns(pNode->GetDecorators()[1]));
+    g.GetArena().Free(pAligned);
+    REQUIRE_FALSE(g.GetArena().Owns(pAligned));
+
+    // So a decorator in one is given back to the arena, not deleted
+    pNode->AddDecorator(new (pLarge) NodeDecorator(DecoratorType::Line));
+    pNode->ClearDecorators();
+    REQUIRE_FALSE(g.GetArena().Owns(pLarge));
+
+    for (int count = 0; count < 1000; count++)
+    {
+        g.CreateNode<FlowTestNode>();
+    }
+    REQUIRE(g.GetArena().GetNumBlocks() > 1);
+
+    // Destroyed memory is reused for the next node of the same size
+    auto pVictim = g.GetNodes().back();
+    g.DestroyNode(pVictim);
+    REQUIRE(g.CreateNode<FlowTestNode>() == pVictim);
+
+    g.Clear();
+    REQUIRE(g.GetArena().GetNumBlocks() == 1);
+    REQUIRE(g.GetNodes().empty());
+}
+
+TEST_CASE("Pin lookup", "[Nodes]")
+{
+    Graph g;
+    auto pNode = g.CreateNode<TestNode>();
+
+    REQUIRE(pNode->GetPin("Value2") == pNode->pValue2);
+    REQUIRE(pNode->GetPin("Sum") == pNode->pSum);
+    REQUIRE(pNode->GetPin("Missing") == nullptr);
+    REQUIRE(pNode->GetInput("Sum") == nullptr);
+    REQUIRE(pNode->GetOutput("Sum") == pNode->pSum);
+
+    MUtils::StringId value1("Value1");
+    REQUIRE(pNode->GetPinById(value1) == pNode->pValue1);
+
+    // Two names with the same id still find their own pins
+    std::unordered_map<uint32_t, std::string> names;
+    std::string first;
+    std::string second;
+    for (uint32_t index = 0; first.empty(); index++)
+    {
+        auto name = "Pin" + std::to_string(index);
+        auto itr = names.emplace(Node::HashPinName(name), name).first;
+        if (itr->second != name)
+        {
+            first = itr->second;
+            second = name;
+        }
+    }
+    auto pCollide = g.CreateNode<EmptyNode>("Collide");
+    auto pFirst = pCollide->AddInput(first, 0.0f);
+    auto pSecond = pCollide->AddInput(second, 0.0f);
+    REQUIRE(pCollide->GetPinById(MUtils::StringId(second)) == pSecond);
+    REQUIRE(pCollide->GetPinById(MUtils::StringId(first)) == pFirst);
+    REQUIRE(pNode->GetPinById(MUtils::StringId(first)) == nullptr);
+
+    // Generated inputs are found by name too
+    auto pSource = g.CreateNode<FlowTestNode>();
+    auto pTarget = g.CreateNode<EmptyNode>("Target");
+    pSource->ConnectTo(pTarget);
+    REQUIRE(pTarget->GetPin("Flow_0") == pTarget->GetFlowInputs()[0]);
+}
+
+TEST_CASE("Find by type", "[NodeGraph]")
+{
+    Graph g;
+    auto pAdder = g.CreateNode<TestNode>();
+    std::vector<FlowTestNode*> flows;
+    for (int count = 0; count < 4; count++)
+    {
+        flows.push_back(g.CreateNode<FlowTestNode>());
+    }
+
+    REQUIRE(g.Find<FlowTestNode>(FlowTestNode::TypeID()).size() == 4);
+    REQUIRE(g.Find<EmptyNode>(EmptyNode::TypeID()).empty());
+
+    // Removing from the middle keeps the rest
+    g.DestroyNode(flows[1]);
+    std::set<FlowTestNode*> found;
+    for (auto pFound : g.Find<FlowTestNode>(FlowTestNode::TypeID()))
+    {
+        found.insert(pFound);
+    }
+    REQUIRE(found == std::set<FlowTestNode*>{ flows[0], flows[2], flows[3] });
+
+    auto all = g.Find<Node>({ TestNode::TypeID(), FlowTestNode::TypeID(), TestNode::TypeID() });
+    REQUIRE(all.size() == 4);
+    REQUIRE(std::count(all.begin(), all.end(), pAdder) == 1);
+}
+
+TEST_CASE("Graph transaction", "[NodeGraph]")
+{
+    // Outlive the graph; it sends a change set as it is destroyed
+    int beginCount = 0;
+    std::vector<GraphChangeSet> changes;
+
+    Graph g;
+    auto pExisting = g.CreateNode<FlowTestNode>();
+    g.sigBeginModify.connect([&](Graph*) { beginCount++; });
+    g.sigChanged.connect([&](Graph*, const GraphChangeSet& changeSet) { changes.push_back(changeSet); });
+
+    SECTION("Commit sends one change set")
+    {
+        GraphTransaction transaction(g);
+        std::vector<Node*> chain{ pExisting };
+        for (int count = 0; count < 100; count++)
+        {
+            chain.push_back(transaction.CreateNode<FlowTestNode>());
+            transaction.Connect(chain[chain.size() - 2], chain.back());
+        }
+        auto pTemp = transaction.CreateNode<FlowTestNode>();
+        transaction.Destroy(pTemp);
+        transaction.Commit();
+
+        REQUIRE(beginCount == 1);
+        REQUIRE(changes.size() == 1);
+        REQUIRE(changes[0].addedNodes.size() == 100);
+        REQUIRE(changes[0].addedConnections.size() == 100);
+        REQUIRE(changes[0].removedNodes.empty());
+        REQUIRE(g.GetNodes().size() == 101);
+        REQUIRE(chain.back()->GetFlowInputs()[0]->GetSource() == chain[99]->GetOutputs()[0]);
+    }
+
+    SECTION("Bad edits are caught before anything is applied")
+    {
+        GraphTransaction transaction(g);
+        auto pNode = transaction.CreateNode<FlowTestNode>();
+        transaction.Connect(pExisting, pNode);
+        transaction.Connect(pNode, pExisting, "Missing");
+        REQUIRE_THROWS_WITH(transaction.Commit(), "Can't find output pin: Missing");
+
+        REQUIRE_FALSE(transaction.IsOpen());
+        REQUIRE(g.GetNodes().size() == 1);
+        REQUIRE(pExisting->GetOutputs()[0]->GetTargets().empty());
+        REQUIRE(changes.size() == 1);
+        REQUIRE(changes[0].Empty());
+    }
+
+    SECTION("A cycle undoes the connections already made")
+    {
+        GraphTransaction transaction(g);
+        auto pNode = transaction.CreateNode<FlowTestNode>();
+        transaction.Connect(pExisting, pNode);
+        transaction.Connect(pNode, pExisting);
+        REQUIRE_THROWS_WITH(transaction.Commit(), "Connection would create a cycle");
+
+        REQUIRE(g.GetNodes().size() == 1);
+        REQUIRE(pExisting->GetOutputs()[0]->GetTargets().empty());
+        REQUIRE(changes[0].Empty());
+    }
+
+    SECTION("Broken connections are reported")
+    {
+        auto pMiddle = g.CreateNode<FlowTestNode>();
+        auto pEnd = g.CreateNode<FlowTestNode>();
+        auto pOther = g.CreateNode<FlowTestNode>();
+        pExisting->ConnectTo(pMiddle);
+        pMiddle->ConnectTo(pEnd);
+        auto pInput = pMiddle->GetFlowInputs()[0];
+        changes.clear();
+
+        // Rewire the middle, and take the end away with its connection
+        {
+            GraphTransaction transaction(g);
+            transaction.Disconnect(pExisting, pMiddle);
+            transaction.Connect(pOther, pMiddle, "Flow", pInput->GetName());
+            transaction.Destroy(pEnd);
+            transaction.Commit();
+        }
+
+        REQUIRE(changes.size() == 1);
+        REQUIRE(changes[0].removedNodes.size() == 1);
+        REQUIRE(changes[0].addedConnections.size() == 1);
+        REQUIRE(changes[0].removedConnections.size() == 2);
+        REQUIRE(changes[0].removedConnections[0].pInput == pInput);
+        REQUIRE(changes[0].removedConnections[0].pOutput == pExisting->GetOutputs()[0]);
+        REQUIRE(pInput->GetSource() == pOther->GetOutputs()[0]);
+
+        // A failed commit puts broken connections back, and reports nothing
+        changes.clear();
+        {
+            GraphTransaction transaction(g);
+            transaction.Disconnect(pOther, pMiddle);
+            transaction.Connect(pMiddle, pExisting);
+            transaction.Connect(pExisting, pMiddle);
+            REQUIRE_THROWS_WITH(transaction.Commit(), "Connection would create a cycle");
+        }
+        REQUIRE(pInput->GetSource() == pOther->GetOutputs()[0]);
+        REQUIRE(changes.size() == 1);
+        REQUIRE(changes[0].Empty());
+
+        {
+            GraphTransaction transaction(g);
+            transaction.Disconnect(pExisting, pMiddle);
+            REQUIRE_THROWS_WITH(transaction.Commit(), "Pins aren't connected: Flow");
+        }
+    }
+}
+
+TEST_CASE("Flow data channels", "[FlowData]")
+{
+    FlowData data(FlowType_Audio, ParameterType::Float);
+    data.GetChannelById(1, 4)->Val<float>(2) = 0.5f;
+    data.GetChannelById(100, 2);
+    data.GetChannelById(20, 2);
+    data.From(0.25f, 0);
+
+    REQUIRE(data.GetNumChannels() == 4);
+    REQUIRE(data.HasChannelId(20));
+    REQUIRE_FALSE(data.HasChannelId(2));
+    REQUIRE(data.GetNumSamples(1) == 4);
+    REQUIRE(data.GetNumSamples(5) == 0);
+    REQUIRE(data.ToFloatPtr(1)[2] == 0.5f);
+
+    // Ids come back in order, inline and sparse alike
+    std::vector<uint32_t> ids;
+    for (auto& [id, channel] : data.GetChannels())
+    {
+        ids.push_back(id);
+    }
+    REQUIRE(ids == std::vector<uint32_t>{ 0, 1, 20, 100 });
+
+    FlowData match(FlowType_Audio, ParameterType::Float);
+    match.MatchChannelInput(data);
+    REQUIRE(match.GetNumChannels() == 4);
+    REQUIRE(match.GetNumSamples(100) == 2);
+}
+
+TEST_CASE("Channel storage", "[FlowData]")
+{
+    Channel channel(3 * sizeof(float));
+    REQUIRE(uintptr_t(channel.Ptr<float>()) % Channel::Alignment == 0);
+    REQUIRE(channel.PaddedByteSize() == Channel::Alignment);
+    REQUIRE(channel.Span<float>().size() == 3);
+
+    channel.Val<float>(2) = 1.0f;
+    channel.SetSizeInBytes(200);
+    REQUIRE(uintptr_t(channel.Ptr<float>()) % Channel::Alignment == 0);
+    REQUIRE(channel.Val<float>(2) == 1.0f);
+
+    // Shrinking zeroes what is now padding
+    channel.SetSizeInBytes(2 * sizeof(float));
+    auto pPadded = channel.Ptr<float>();
+    for (uint32_t index = 2; index < channel.PaddedByteSize() / sizeof(float); index++)
+    {
+        REQUIRE(pPadded[index] == 0.0f);
+    }
+
+    // Copies share until written
+    Channel copy(channel);
+    REQUIRE(copy.ByteSize() == channel.ByteSize());
+    REQUIRE(copy.IsShared());
+    REQUIRE(static_cast<const Channel&>(copy).Ptr<float>() == static_cast<const Channel&>(channel).Ptr<float>());
+
+    copy.Val<float>(0) = 2.0f;
+    REQUIRE_FALSE(copy.IsShared());
+    REQUIRE(copy.Val<float>(0) == 2.0f);
+    REQUIRE(channel.Val<float>(0) == 0.0f);
+}
+
+TEST_CASE("Flow pass through", "[FlowData]")
+{
+    FlowData source(FlowType_Audio, ParameterType::Float);
+    for (uint32_t id = 0; id < 16; id++)
+    {
+        source.GetChannelById(id, 512)->Val<float>(0) = float(id);
+    }
+
+    FlowData through(FlowType_Audio, ParameterType::Float);
+    through.MatchChannelInput(source, true);
+    REQUIRE(through.GetNumChannels() == 16);
+    REQUIRE(through.ToFloatPtr(5) == source.ToFloatPtr(5));
+
+    // Writing one channel only copies that one
+    through.GetChannelById(5, 512)->Val<float>(0) = 100.0f;
+    REQUIRE(through.ToFloatPtr(5) != source.ToFloatPtr(5));
+    REQUIRE(through.ToFloatPtr(6) == source.ToFloatPtr(6));
+    REQUIRE(source.ToFloatPtr(5)[0] == 5.0f);
+
+    // So does writing through WritePtr
+    static_cast<float*>(through.WritePtr(6))[0] = 100.0f;
+    REQUIRE(through.ToFloatPtr(6) != source.ToFloatPtr(6));
+    REQUIRE(source.ToFloatPtr(6)[0] == 6.0f);
+}
+
+// Adds one to its flow input, writing a block of samples
+class BlockTestNode : public Node
+{
+public:
+    DECLARE_NODE(BlockTestNode, blocktest);
+
+    BlockTestNode(Graph& m_graph, std::set<float*>* pBuffers)
+        : Node(m_graph, "Block")
+        , m_pBuffers(pBuffers)
+    {
+        pOutput = AddOutputFlow("Flow", new FlowData(FlowType_Audio, ParameterType::Float));
+    }
+
+    virtual void Compute() override
+    {
+        float in = 0.0f;
+        if (!GetFlowInputs().empty())
+        {
+            in = GetFlowInputs()[0]->GetFlowData()->ToFloatPtr(0)[255];
+        }
+
+        auto pOut = pOutput->GetFlowData()->GetChannelById(0, 256)->Ptr<float>();
+        for (uint32_t sample = 0; sample < 256; sample++)
+        {
+            pOut[sample] = in + 1.0f;
+        }
+        m_pBuffers->insert(pOut);
+    }
+
+    Pin* pOutput = nullptr;
+    std::set<float*>* m_pBuffers;
+};
+
+TEST_CASE("Flow buffer pooling", "[Compute]")
+{
+    std::set<float*> buffers;
+    Graph g;
+    std::vector<BlockTestNode*> chain;
+    for (int count = 0; count < 4; count++)
+    {
+        chain.push_back(g.CreateNode<BlockTestNode>(&buffers));
+        if (count > 0)
+        {
+            chain[count - 1]->ConnectTo(chain[count]);
+        }
+    }
+    g.SetFlowBufferPooling(true);
+
+    for (int tick = 0; tick < 2; tick++)
+    {
+        g.Compute(std::set<Node*>{ chain.back() }, tick);
+        REQUIRE(chain.back()->pOutput->GetFlowData()->ToFloatPtr(0)[0] == 4.0f);
+    }
+
+    // Only a writer and its reader are live at once, plus the output node's buffer, which is kept
+    REQUIRE(buffers.size() == 3);
+    REQUIRE(chain[0]->pOutput->GetFlowData()->GetNumChannels() == 0);
+    REQUIRE(chain[2]->pOutput->GetFlowData()->GetNumChannels() == 0);
+    REQUIRE(chain[3]->pOutput->GetFlowData()->GetNumChannels() == 1);
+    REQUIRE(g.GetFlowBufferPool().GetNumFree() == 2);
+}
+
+TEST_CASE("Flow conversion", "[FlowData]")
+{
+    // Odd lengths run the SIMD loops and the scalar tails
+    const uint32_t NumSamples = 37;
+    FlowData data(FlowType_Audio, ParameterType::Float);
+    auto samples = data.GetChannelById(0, NumSamples)->Span<float>();
+    for (uint32_t sample = 0; sample < NumSamples; sample++)
+    {
+        samples[sample] = (sample % 3) == 0 ? 0.0f : float(sample) + 0.5f;
+    }
+
+    // Each type is converted into a buffer of its own
+    auto pDouble = (const double*)data.ToPtr(ParameterType::Double);
+    for (uint32_t sample = 0; sample < NumSamples; sample++)
+    {
+        REQUIRE(pDouble[sample] == double(samples[sample]));
+    }
+
+    auto pInt = (const int64_t*)data.ToPtr(ParameterType::Int64);
+    for (uint32_t sample = 0; sample < NumSamples; sample++)
+    {
+        REQUIRE(pInt[sample] == int64_t(samples[sample]));
+    }
+
+    auto pBool = (const bool*)data.ToPtr(ParameterType::Bool);
+    for (uint32_t sample = 0; sample < NumSamples; sample++)
+    {
+        REQUIRE(pBool[sample] == (samples[sample] != 0.0f));
+    }
+
+    // And back again through every kernel
+    std::vector<double> doubles(NumSamples);
+    std::vector<float> floats(NumSamples);
+    std::vector<uint8_t> bools(NumSamples);
+    REQUIRE(ConvertSamples(ParameterType::Float, samples.data(), ParameterType::Double, doubles.data(), NumSamples));
+    REQUIRE(ConvertSamples(ParameterType::Double, doubles.data(), ParameterType::Float, floats.data(), NumSamples));
+    REQUIRE(floats == std::vector<float>(samples.begin(), samples.end()));
+    REQUIRE(ConvertSamples(ParameterType::Float, samples.data(), ParameterType::Bool, bools.data(), NumSamples));
+    REQUIRE(ConvertSamples(ParameterType::Bool, bools.data(), ParameterType::Float, floats.data(), NumSamples));
+    REQUIRE(floats[3] == 0.0f);
+    REQUIRE(floats[4] == 1.0f);
+    REQUIRE_FALSE(ConvertSamples(ParameterType::String, samples.data(), ParameterType::Float, floats.data(), NumSamples));
+
+    Parameter param((IFlowData*)&data);
+    REQUIRE(param.To<double>() == 0.0);
+    samples[0] = 2.0f;
+    REQUIRE(param.To<int64_t>() == 2);
+    REQUIRE(param.To<bool>());
+}
+
+TEST_CASE("Flow conversion cache", "[FlowData]")
+{
+    FlowData data(FlowType_Audio, ParameterType::Float);
+    data.GetChannelById(0, 4)->Val<float>(1) = 1.5f;
+
+    // Reading again gives the same conversion without redoing it
+    auto pDouble = (const double*)data.ToPtr(ParameterType::Double);
+    REQUIRE(pDouble[1] == 1.5);
+    auto generation = data.GetChannels().Find(0)->GetGeneration();
+    REQUIRE(data.ToPtr(ParameterType::Double) == pDouble);
+    REQUIRE(data.GetChannels().Find(0)->GetGeneration() == generation);
+
+    // A write moves the generation on, so the next read converts again
+    data.GetChannelById(0, 4)->Val<float>(1) = 2.5f;
+    REQUIRE(data.GetChannels().Find(0)->GetGeneration() != generation);
+    REQUIRE(((const double*)data.ToPtr(ParameterType::Double))[1] == 2.5);
+
+    // A copy shares the generation with the storage; writing to it leaves the original alone
+    FlowData copy(FlowType_Audio, ParameterType::Float);
+    copy.MatchChannelInput(data, true);
+    REQUIRE(copy.GetChannels().Find(0)->GetGeneration() == data.GetChannels().Find(0)->GetGeneration());
+    copy.GetChannelById(0, 4)->Val<float>(1) = 3.5f;
+    REQUIRE(((const double*)copy.ToPtr(ParameterType::Double))[1] == 3.5);
+    REQUIRE(((const double*)data.ToPtr(ParameterType::Double))[1] == 2.5);
+}
+
+// Doubles its typed input into a typed output
+class TypedTestNode : public Node
+{
+public:
+    DECLARE_NODE(TypedTestNode, typedtest);
+
+    TypedTestNode(Graph& m_graph)
+        : Node(m_graph, "Typed")
+    {
+        AddInputFlow<double>("Flow");
+        m_pOutput = AddOutputFlow<double>("Flow")->GetTypedFlowData<double>();
+    }
+
+    virtual void Compute() override
+    {
+        auto in = ReadFlowSamples<double>(*GetInput("Flow")->GetFlowData());
+        auto out = m_pOutput->GetSamples(0, 4);
+        for (uint32_t sample = 0; sample < 4; sample++)
+        {
+            out[sample] = in.empty() ? 1.0 : in[sample] * 2.0;
+        }
+    }
+
+    TypedFlowData<double>* m_pOutput = nullptr;
+};
+
+TEST_CASE("Typed flow data", "[FlowData]")
+{
+    TypedFlowData<int64_t> data;
+    REQUIRE(data.GetParameterType() == ParameterType::Int64);
+    REQUIRE(data.GetSamples().empty());
+
+    data.GetSamples(0, 3)[2] = 7;
+    REQUIRE(data.GetNumSamples(0) == 3);
+    REQUIRE(data.GetSamples()[2] == 7);
+    REQUIRE(ReadFlowSamples<float>(data)[2] == 7.0f);
+
+    // From keeps the type
+    data.From(2.0f, 1);
+    REQUIRE(data.GetParameterType() == ParameterType::Int64);
+    REQUIRE(data.GetSamples(1)[0] == 2);
+
+    Graph g;
+    auto pFirst = g.CreateNode<TypedTestNode>();
+    auto pSecond = g.CreateNode<TypedTestNode>();
+    pFirst->ConnectTo(pSecond, "Flow", "Flow");
+    REQUIRE(pSecond->GetInput("Flow")->GetTypedFlowData<double>() == pFirst->m_pOutput);
+    REQUIRE(pFirst->GetOutput("Flow")->GetTypedFlowData<float>() == nullptr);
+
+    g.Compute(std::set<Node*>{ pSecond }, 0);
+    REQUIRE(pSecond->m_pOutput->GetSamples()[3] == 2.0);
+
+    SECTION("Matching another type converts")
+    {
+        FlowData floats(FlowType_Audio, ParameterType::Float);
+        floats.GetChannelById(0, 3)->Val<float>(2) = 1.5f;
+        floats.GetChannelById(4, 5);
+
+        auto pInput = pFirst->GetInput("Flow")->GetTypedFlowData<double>();
+        REQUIRE(pInput != nullptr);
+        pInput->MatchChannelInput(floats, true);
+        REQUIRE(pInput->GetNumChannels() == 2);
+        REQUIRE(pInput->GetSamples().size() == 3);
+        REQUIRE(pInput->GetSamples()[2] == 1.5);
+        REQUIRE(pInput->GetNumSamples(4) == 5);
+        REQUIRE(pInput->GetChannels().Find(0)->GetGeneration() != floats.GetChannels().Find(0)->GetGeneration());
+
+        // Without copying, only the sample counts carry over
+        TypedFlowData<double> sized;
+        sized.MatchChannelInput(floats);
+        REQUIRE(sized.GetSamples(4).size() == 5);
+        REQUIRE(sized.GetSamples()[2] == 0.0);
+
+        // The same type still shares
+        TypedFlowData<double> shared;
+        shared.MatchChannelInput(*pInput, true);
+        REQUIRE(shared.GetSamples().data() == pInput->GetSamples().data());
+    }
+}
+
+TEST_CASE("Parallel flow conversion", "[Compute]")
+{
+    Graph g;
+    g.SetComputeMode(ComputeMode::Parallel, 3);
+
+    // One float output read as doubles by many nodes in the same level
+    std::set<float*> buffers;
+    auto pSource = g.CreateNode<BlockTestNode>(&buffers);
+    std::set<Node*> readers;
+    for (int count = 0; count < 16; count++)
+    {
+        auto pReader = g.CreateNode<TypedTestNode>();
+        pSource->ConnectTo(pReader);
+        readers.insert(pReader);
+    }
+
+    for (int tick = 0; tick < 4; tick++)
+    {
+        g.Compute(readers, tick);
+        for (auto& pReader : readers)
+        {
+            REQUIRE(static_cast<TypedTestNode*>(pReader)->m_pOutput->GetSamples()[3] == 2.0);
+        }
+    }
+}
+
+TEST_CASE("Event flow data", "[FlowData]")
+{
+    EventFlowData events(3);
+    REQUIRE(events.GetCapacity() == 4);
+    REQUIRE(events.GetFlowType() == FlowType_Midi);
+    REQUIRE(events.GetNumChannels() == 0);
+
+    // Out of order pushes are sorted; equal offsets keep their order
+    REQUIRE(events.Push(10, 0x90, 60, 100));
+    REQUIRE(events.Push(2, 0x90, 64, 100));
+    REQUIRE(events.Push(10, 0x80, 64));
+    REQUIRE(events.Push(300, 0x80, 60));
+    REQUIRE_FALSE(events.Push(5, 0x90));
+
+    std::vector<FlowEvent> played;
+    events.VisitEvents(256, [&](const FlowEvent& event) {
+        played.push_back(event);
+    });
+    REQUIRE(played.size() == 3);
+    REQUIRE(played[0].offset == 2);
+    REQUIRE(played[1].data1 == 60);
+    REQUIRE(played[2].status == 0x80);
+
+    // The late event carries into the next block, and the ring wraps
+    events.Advance(256);
+    REQUIRE(events.GetNumEvents() == 1);
+    REQUIRE(events.GetEvent(0).offset == 44);
+    REQUIRE(events.Push(0, 0xB0, 7, 127));
+    REQUIRE(events.GetEvent(0).status == 0xB0);
+    REQUIRE(events.GetEvent(1).offset == 44);
+
+    EventFlowData copy;
+    copy.MatchChannelInput(events, true);
+    REQUIRE(copy.GetNumEvents() == 2);
+    REQUIRE(copy.GetEvent(1).data1 == 60);
+}
+
+TEST_CASE("Parameter block ramp", "[Parameters]")
+{
+    Parameter p(0.0f);
+    p.SetLerpSamples(8);
+    p.Update(100);
+    p.Set(1.0f);
+
+    // The lerp starts at tick 100 and finishes at 108
+    std::vector<float> block(16);
+    REQUIRE(p.UpdateBlock(98, block) == BlockFill::Samples);
+    REQUIRE(block[0] == 0.0f);
+    REQUIRE(block[2] == 0.0f);
+    REQUIRE(block[6] == 0.5f);
+    REQUIRE(block[10] == 1.0f);
+    REQUIRE(block[15] == 1.0f);
+    REQUIRE(p.To<float>() == 1.0f);
+
+    // Settled; the block is left alone and the generation doesn't move
+    auto generation = p.GetGeneration();
+    std::fill(block.begin(), block.end(), -1.0f);
+    REQUIRE(p.UpdateBlock(114, block) == BlockFill::Constant);
+    REQUIRE(p.UpdateBlock(130, block) == BlockFill::Constant);
+    REQUIRE(block[0] == -1.0f);
+    REQUIRE(block[15] == -1.0f);
+    REQUIRE(p.To<float>() == 1.0f);
+    REQUIRE(p.GetGeneration() == generation);
+
+    // A tick from before the lerp started holds the start value, rather than wrapping
+    p.Set(0.0f);
+    REQUIRE(p.Update(100).To<float>() == 1.0f);
+    REQUIRE(p.UpdateBlock(146, gsl::span<float>(block.data(), 4)) == BlockFill::Samples);
+    REQUIRE(block[3] == 0.5f);
+
+    // Integers ramp in whole steps
+    Parameter count(int64_t(0));
+    count.SetLerpSamples(4);
+    count.Update(0);
+    count.Set(int64_t(3));
+    REQUIRE(count.UpdateBlock(0, gsl::span<float>(block.data(), 6)) == BlockFill::Samples);
+    REQUIRE(std::vector<float>(block.begin(), block.begin() + 6) == std::vector<float>{ 0.0f, 0.0f, 1.0f, 2.0f, 3.0f, 3.0f });
+
+    Parameter text(std::string("text"));
+    block[0] = 5.0f;
+    REQUIRE(text.UpdateBlock(0, block) == BlockFill::None);
+    REQUIRE(block[0] == 5.0f);
+}
+
+TEST_CASE("Parameter ramps", "[Compute]")
+{
+    Graph g;
+    auto pNode = g.CreateNode<TestNode>();
+    auto& ramps = g.GetParameterRamps();
+    g.Compute(std::set<Node*>{ pNode }, 0);
+
+    // Idle pins aren't in the ramps; one that is set without a lerp changes straight away
+    pNode->pValue2->Set(0.25f);
+    REQUIRE(ramps.GetNumRamps() == 0);
+    REQUIRE(pNode->pValue2->To<float>() == 0.25f);
+
+    pNode->pValue1->SetLerpSamples(4);
+    pNode->pValue1->Set(1.0f);
+    REQUIRE(pNode->pValue1->IsRamping());
+    REQUIRE(ramps.GetNumRamps() == 1);
+
+    g.Compute(std::set<Node*>{ pNode }, 2);
+    REQUIRE(pNode->pValue1->To<float>() == 0.5f);
+    REQUIRE(pNode->pSum->To<float>() == 0.75f);
+
+    // Finished ramps land exactly on the end value and leave
+    g.Compute(std::set<Node*>{ pNode }, 5);
+    REQUIRE(pNode->pValue1->To<float>() == 1.0f);
+    REQUIRE_FALSE(pNode->pValue1->IsRamping());
+    REQUIRE(ramps.GetNumRamps() == 0);
+
+    // A pin destroyed mid ramp takes itself out
+    pNode->pValue1->Set(0.0f);
+    REQUIRE(ramps.GetNumRamps() == 1);
+    g.DestroyNode(pNode);
+    REQUIRE(ramps.GetNumRamps() == 0);
+}
+
+// Lerps its output to target when it computes, and reads its input as a dependent would
+class OutputLerpTestNode : public Node
+{
+public:
+    DECLARE_NODE(OutputLerpTestNode, outputlerptest);
+
+    explicit OutputLerpTestNode(Graph& m_graph)
+        : Node(m_graph, "OutputLerp")
+    {
+        AddOutputFlow("Flow", new FlowData(FlowType_Data, ParameterType::Float));
+        pOutput = AddOutput("Value", 0.0f);
+        pOutput->SetLerpSamples(4);
+        pInput = AddInput("Value", 0.0f);
+    }
+
+    virtual void Compute() override
+    {
+        pOutput->Set(target);
+        read = pInput->GetValue<float>();
+    }
+
+    Pin* pOutput = nullptr;
+    Pin* pInput = nullptr;
+    float target = 0.0f;
+    float read = 0.0f;
+};
+
+TEST_CASE("Output lerps", "[Compute]")
+{
+    Graph g;
+    SECTION("Serial")
+    {
+    }
+    SECTION("Parallel")
+    {
+        g.SetComputeMode(ComputeMode::Parallel, 3);
+    }
+
+    auto pFirst = g.CreateNode<OutputLerpTestNode>();
+    auto pSecond = g.CreateNode<OutputLerpTestNode>();
+    // The flow puts them in order
+    pFirst->ConnectTo(pSecond);
+    pFirst->ConnectTo(pSecond, "Value", "Value");
+    g.Compute(std::set<Node*>{ pSecond }, 0);
+
+    // A lerp started in compute has moved on by the time its dependents read it, as it did before the ramps
+    pFirst->target = 1.0f;
+    g.Compute(std::set<Node*>{ pSecond }, 2);
+    REQUIRE(pFirst->pOutput->To<float>() == 0.5f);
+    REQUIRE(pSecond->read == 0.5f);
+
+    g.Compute(std::set<Node*>{ pSecond }, 3);
+    REQUIRE(pSecond->read == 0.75f);
+
+    g.Compute(std::set<Node*>{ pSecond }, 6);
+    REQUIRE(pSecond->read == 1.0f);
+    REQUIRE(g.GetParameterRamps().GetNumRamps() == 0);
+}
+
+TEST_CASE("Parameter value footprint", "[Parameters]")
+{
+    REQUIRE(sizeof(ParameterValue) == 16);
+
+    // Copies share the string; a new one replaces it
+    ParameterValue text(std::string("a long enough string to need the heap"));
+    ParameterValue copy(text);
+    REQUIRE(copy.pSVal == text.pSVal);
+    bool same = copy == text;
+    REQUIRE(same);
+    copy = std::string("other");
+    REQUIRE(text.GetString() == "a long enough string to need the heap");
+    REQUIRE(copy.To<std::string>() == "other");
+
+    ParameterValue moved(std::move(copy));
+    REQUIRE(moved.GetString() == "other");
+    REQUIRE(copy.type == ParameterType::None);
+
+    moved = text;
+    REQUIRE(moved.pSVal == text.pSVal);
+    moved = ParameterValue(1.5f);
+    REQUIRE(moved.GetString().empty());
+    REQUIRE(moved.To<float>() == 1.5f);
+}
+
+TEST_CASE("Shared parameter attributes", "[Parameters]")
+{
+    Graph g;
+    auto pFirst = g.CreateNode<TestNode>();
+    auto pSecond = g.CreateNode<TestNode>();
+
+    // Every instance shares one block per definition
+    REQUIRE(&pFirst->pValue1->GetAttributes() == &pSecond->pValue1->GetAttributes());
+    REQUIRE(&pFirst->pValue1->GetAttributes() == &pFirst->pValue2->GetAttributes());
+
+    // Changing them moves the pin to another block, leaving the old one alone
+    pSecond->pValue1->ModifyAttributes([](ParameterAttributes& attrib) { attrib.postFix = "Hz"; });
+    REQUIRE(pSecond->pValue1->GetAttributes().postFix == "Hz");
+    REQUIRE(pFirst->pValue1->GetAttributes().postFix.empty());
+    REQUIRE(pFirst->pValue1->GetAttributes().max.To<float>() == 1.0f);
+
+    // Pins changed the same way share the result
+    pFirst->pValue1->ModifyAttributes([](ParameterAttributes& attrib) { attrib.postFix = "Hz"; });
+    REQUIRE(&pFirst->pValue1->GetAttributes() == &pSecond->pValue1->GetAttributes());
+
+    Parameter text(std::string("text"));
+    REQUIRE(text.GetAttributes().ui == ParameterUI::Text);
+}
+
+TEST_CASE("Queued parameter changes", "[Compute]")
+{
+    Graph g;
+    auto pNode = g.CreateNode<TestNode>();
+    pNode->pValue1->SetAttributes(ParameterAttributes(ParameterUI::Knob, 0.0f, 2.0f));
+
+    // Nothing changes until compute applies the queue
+    g.QueueParameterChange(*pNode->pValue2, ParameterValue(0.25f));
+    g.QueueParameterChangeNormalized(*pNode->pValue1, 0.5);
+    REQUIRE(pNode->pValue1->To<float>() == 0.0f);
+
+    g.Compute(std::set<Node*>{ pNode }, 0);
+    REQUIRE(pNode->pValue1->To<float>() == 1.0f);
+    REQUIRE(pNode->pSum->To<float>() == 1.25f);
+
+    // A lerp starts the given number of ticks into the compute
+    pNode->pValue2->SetLerpSamples(4);
+    g.QueueParameterChange(*pNode->pValue2, ParameterValue(1.25f), 2);
+    g.Compute(std::set<Node*>{ pNode }, 10);
+    g.Compute(std::set<Node*>{ pNode }, 12);
+    REQUIRE(pNode->pValue2->To<float>() == 0.25f);
+    g.Compute(std::set<Node*>{ pNode }, 14);
+    REQUIRE(pNode->pValue2->To<float>() == 0.75f);
+
+    // A pin that doesn't lerp takes the change for the whole tick, whatever the offset
+    g.QueueParameterChange(*pNode->pValue1, ParameterValue(1.5f), 2);
+    g.Compute(std::set<Node*>{ pNode }, 16);
+    REQUIRE(pNode->pValue1->To<float>() == 1.5f);
+    REQUIRE_FALSE(pNode->pValue1->IsRamping());
+
+    // Strings can't be queued
+    REQUIRE_THROWS_AS(g.QueueParameterChange(*pNode->pValue2, ParameterValue(std::string("text"))), std::invalid_argument);
+
+    // Changes for a node that has gone are dropped
+    g.QueueParameterChange(*pNode->pValue2, ParameterValue(0.0f));
+    g.DestroyNode(pNode);
+    g.ApplyParameterChanges();
+}
+
+TEST_CASE("Automation timeline", "[Parameters]")
+{
+    auto spTimeline = std::make_shared<AutomationTimeline>(4);
+    REQUIRE(spTimeline->Add(10, 1.0));
+    REQUIRE(spTimeline->Add(0, 0.0));
+    REQUIRE(spTimeline->Add(10, 2.0, 2.0f));
+    REQUIRE(spTimeline->Add(20, 4.0));
+    REQUIRE_FALSE(spTimeline->Add(30, 0.0));
+
+    // Linear up to the step at 10, then flat at the end
+    uint32_t cursor = 0;
+    REQUIRE(spTimeline->ValueAt(5, cursor) == 0.5);
+    REQUIRE(spTimeline->ValueAt(10, cursor) == 2.0);
+    REQUIRE(spTimeline->ValueAt(25, cursor) == 4.0);
+    REQUIRE(spTimeline->ValueAt(-5, cursor) == 0.0);
+
+    // The curved segment bends late
+    REQUIRE(spTimeline->ValueAt(15, cursor) < 3.0);
+
+    Parameter param(0.0f);
+    param.SetAutomation(spTimeline);
+    std::vector<float> block(4);
+    REQUIRE(param.UpdateBlock(8, block) == BlockFill::Samples);
+    REQUIRE(block[0] == Approx(0.8f));
+    REQUIRE(block[1] == Approx(0.9f));
+    REQUIRE(block[2] == 2.0f);
+    REQUIRE(param.To<float>() > 2.0f);
+
+    // Trimming keeps the segment we are in
+    spTimeline->Trim(15);
+    REQUIRE(spTimeline->GetPoints().size() == 2);
+    cursor = 0;
+    REQUIRE(spTimeline->ValueAt(20, cursor) == 4.0);
+
+    // Pins in a graph are walked every tick, and win over a Set
+    Graph g;
+    auto pNode = g.CreateNode<TestNode>();
+    auto& ramps = g.GetParameterRamps();
+    pNode->pValue1->SetAutomation(spTimeline);
+    REQUIRE(ramps.GetNumAutomated() == 1);
+
+    g.Compute(std::set<Node*>{ pNode }, 20);
+    REQUIRE(pNode->pValue1->To<float>() == 4.0f);
+    pNode->pValue1->Set(1.0f);
+    g.Compute(std::set<Node*>{ pNode }, 21);
+    REQUIRE(pNode->pValue1->To<float>() == 4.0f);
+
+    pNode->pValue1->SetAutomation(nullptr);
+    REQUIRE(ramps.GetNumAutomated() == 0);
+    pNode->pValue1->SetAutomation(spTimeline);
+    g.DestroyNode(pNode);
+    REQUIRE(ramps.GetNumAutomated() == 0);
+}
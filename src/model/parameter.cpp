@@ -0,0 +1,266 @@
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "nodegraph/model/parameter.h"
+#include "nodegraph/model/automation.h"
+#include "nodegraph/model/flow_convert.h"
+#include "nodegraph/model/parameter_ramps.h"
+
+namespace NodeGraph
+{
+
+namespace
+{
+
+void HashCombine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t HashValue(const ParameterValue& value)
+{
+    size_t hash = size_t(value.type);
+    switch (value.type)
+    {
+    case ParameterType::Float:
+        HashCombine(hash, std::hash<float>()(value.fVal));
+        break;
+    case ParameterType::Double:
+        HashCombine(hash, std::hash<double>()(value.dVal));
+        break;
+    case ParameterType::Int64:
+        HashCombine(hash, std::hash<int64_t>()(value.iVal));
+        break;
+    case ParameterType::Bool:
+        HashCombine(hash, std::hash<bool>()(value.bVal));
+        break;
+    case ParameterType::String:
+        HashCombine(hash, std::hash<std::string>()(value.GetString()));
+        break;
+    default:
+        break;
+    }
+    return hash;
+}
+
+size_t HashAttributes(const ParameterAttributes& attributes)
+{
+    size_t hash = 0;
+    for (auto pValue : { &attributes.min, &attributes.max, &attributes.origin, &attributes.step, &attributes.thumb })
+    {
+        HashCombine(hash, HashValue(*pValue));
+    }
+    HashCombine(hash, size_t(attributes.ui));
+    HashCombine(hash, size_t(attributes.displayType));
+    HashCombine(hash, attributes.flags);
+    HashCombine(hash, std::hash<float>()(attributes.taper));
+    HashCombine(hash, std::hash<std::string>()(attributes.postFix));
+    for (auto& label : attributes.labels)
+    {
+        HashCombine(hash, std::hash<std::string>()(label));
+    }
+    return hash;
+}
+
+bool SameValue(const ParameterValue& lhs, const ParameterValue& rhs)
+{
+    // Unset values have nothing to compare
+    return lhs.type == rhs.type && (lhs.type == ParameterType::None || lhs == rhs);
+}
+
+bool SameAttributes(const ParameterAttributes& lhs, const ParameterAttributes& rhs)
+{
+    return SameValue(lhs.min, rhs.min) && SameValue(lhs.max, rhs.max) && SameValue(lhs.origin, rhs.origin) && SameValue(lhs.step, rhs.step) && SameValue(lhs.thumb, rhs.thumb) && lhs.ui == rhs.ui && lhs.multiSelect == rhs.multiSelect && lhs.displayType == rhs.displayType && lhs.postFix == rhs.postFix && lhs.flags == rhs.flags && lhs.labels == rhs.labels && lhs.taper == rhs.taper;
+}
+
+} // namespace
+
+std::shared_ptr<const ParameterAttributes> Parameter::InternAttributes(const ParameterAttributes& attributes)
+{
+    // Blocks by hash; weak, so a block goes once the last parameter using it does
+    static std::mutex internMutex;
+    static std::unordered_multimap<size_t, std::weak_ptr<const ParameterAttributes>> interned;
+
+    auto hash = HashAttributes(attributes);
+
+    std::lock_guard<std::mutex> lock(internMutex);
+    auto range = interned.equal_range(hash);
+    for (auto itr = range.first; itr != range.second;)
+    {
+        auto spAttributes = itr->second.lock();
+        if (!spAttributes)
+        {
+            itr = interned.erase(itr);
+            continue;
+        }
+
+        if (SameAttributes(*spAttributes, attributes))
+        {
+            return spAttributes;
+        }
+        itr++;
+    }
+
+    std::shared_ptr<const ParameterAttributes> spAttributes = std::make_shared<ParameterAttributes>(attributes);
+    interned.emplace(hash, spAttributes);
+    return spAttributes;
+}
+
+BlockFill Parameter::UpdateBlock(uint64_t tick, gsl::span<float> block)
+{
+    if (m_value.type != ParameterType::Float && m_value.type != ParameterType::Double && m_value.type != ParameterType::Int64 && m_value.type != ParameterType::Bool)
+    {
+        return BlockFill::None;
+    }
+
+    auto numSamples = uint32_t(block.size());
+    if (numSamples == 0)
+    {
+        return BlockFill::Constant;
+    }
+
+    auto pBlock = block.data();
+    auto lastTick = tick + numSamples - 1;
+    uint32_t rampStart = 0;
+    uint32_t rampEnd = 0;
+
+    if (m_spAutomation)
+    {
+        m_spAutomation->Render(int64_t(tick), pBlock, numSamples, m_automationCursor);
+        rampEnd = numSamples;
+    }
+    else
+    {
+        auto endValue = m_endValue.To<float>();
+        if (!(m_value == m_endValue) && m_lerpTicks > 0 && m_value.type != ParameterType::Bool)
+        {
+            // Samples before the lerp starts hold the start value, samples after it the end value
+            auto startValue = m_startValue.To<float>();
+            auto step = (endValue - startValue) / float(m_lerpTicks);
+            auto offset = m_startTick - int64_t(tick);
+            rampStart = uint32_t(std::clamp<int64_t>(offset, 0, numSamples));
+            rampEnd = uint32_t(std::clamp<int64_t>(offset + m_lerpTicks, 0, numSamples));
+
+            std::fill(pBlock, pBlock + rampStart, startValue);
+            FillRamp(pBlock + rampStart, rampEnd - rampStart, startValue + step * float(int64_t(rampStart) - offset), step);
+        }
+
+        // At the end value throughout; nothing to write
+        if (rampEnd == 0)
+        {
+            Parameter::Update(lastTick);
+            return BlockFill::Constant;
+        }
+        std::fill(pBlock + rampEnd, pBlock + numSamples, endValue);
+    }
+
+    // Whole steps, as Update gives
+    if (m_value.type == ParameterType::Int64)
+    {
+        for (auto index = rampStart; index < rampEnd; index++)
+        {
+            pBlock[index] = std::trunc(pBlock[index]);
+        }
+    }
+    else if (m_value.type == ParameterType::Bool)
+    {
+        for (auto index = rampStart; index < rampEnd; index++)
+        {
+            pBlock[index] = pBlock[index] != 0.0f ? 1.0f : 0.0f;
+        }
+    }
+
+    Parameter::Update(lastTick);
+    return BlockFill::Samples;
+}
+
+int64_t Parameter::RampTick() const
+{
+    return m_pRamps->GetTick();
+}
+
+void Parameter::SyncRamp(bool destroying)
+{
+    bool lerps = m_value.type == ParameterType::Float || m_value.type == ParameterType::Double || m_value.type == ParameterType::Int64;
+    if (!destroying && !(m_value == m_endValue))
+    {
+        if (lerps && m_lerpTicks > 0)
+        {
+            m_pRamps->Add(*this);
+            return;
+        }
+
+        // Nothing to lerp over; the ramps would only finish it on the next tick
+        m_value = m_endValue;
+    }
+
+    if (m_rampSlot != NoRamp)
+    {
+        m_pRamps->Remove(*this);
+    }
+}
+
+void Parameter::SetAutomation(std::shared_ptr<AutomationTimeline> spTimeline)
+{
+    m_spAutomation = std::move(spTimeline);
+    m_automationCursor = 0;
+
+    if (m_pRamps)
+    {
+        if (m_spAutomation && m_automationSlot == NoRamp)
+        {
+            m_pRamps->AddAutomation(*this);
+        }
+        else if (!m_spAutomation && m_automationSlot != NoRamp)
+        {
+            m_pRamps->RemoveAutomation(*this);
+        }
+    }
+
+    if (m_spAutomation)
+    {
+        UpdateAutomation(m_currentTick);
+    }
+}
+
+ParameterValue Parameter::UpdateAutomation(uint64_t tick)
+{
+    m_currentTick = tick;
+    if (m_spAutomation->Empty())
+    {
+        return m_value;
+    }
+
+    auto value = m_spAutomation->ValueAt(int64_t(tick), m_automationCursor);
+    ParameterValue next = m_value;
+    switch (m_value.type)
+    {
+    case ParameterType::Float:
+        next.fVal = float(value);
+        break;
+    case ParameterType::Double:
+        next.dVal = value;
+        break;
+    case ParameterType::Int64:
+        next.iVal = int64_t(value);
+        break;
+    case ParameterType::Bool:
+        next.bVal = value != 0.0;
+        break;
+    default:
+        // Not a number; nothing to automate
+        return m_value;
+    }
+
+    // Generation only moves when the value does, so a flat stretch doesn't dirty anything
+    if (!(next == m_value))
+    {
+        m_value = next;
+        m_endValue = next;
+        m_generation++;
+    }
+    return m_value;
+}
+
+} // namespace NodeGraph
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "nodegraph/model/parameter_ramps.h"
+
+namespace NodeGraph
+{
+
+ParameterRamps::WorkerScope::WorkerScope(ParameterRamps& ramps)
+    : m_ramps(ramps)
+{
+    m_ramps.m_workers = true;
+}
+
+ParameterRamps::WorkerScope::~WorkerScope()
+{
+    m_ramps.m_workers = false;
+    m_ramps.SyncHandOver();
+}
+
+void ParameterRamps::SyncHandOver()
+{
+    // The parameters now say what they want; a repeat just restarts from the same tick
+    Parameter* pParam;
+    while (m_handOver.try_dequeue(pParam))
+    {
+        pParam->SyncRamp();
+    }
+}
+
+void ParameterRamps::Add(Parameter& param)
+{
+    if (m_workers)
+    {
+        m_handOver.enqueue(&param);
+        return;
+    }
+
+    if (param.m_rampSlot == Parameter::NoRamp)
+    {
+        param.m_rampSlot = uint32_t(m_params.size());
+        m_params.push_back(&param);
+        m_starts.push_back(0.0);
+        m_deltas.push_back(0.0);
+        m_startTicks.push_back(0.0);
+        m_tickScales.push_back(0.0);
+        m_values.push_back(0.0);
+    }
+
+    auto slot = param.m_rampSlot;
+    m_starts[slot] = param.m_startValue.To<double>();
+    m_deltas[slot] = param.m_endValue.To<double>() - m_starts[slot];
+    m_startTicks[slot] = double(param.m_startTick);
+    m_tickScales[slot] = 1.0 / double(param.m_lerpTicks);
+}
+
+void ParameterRamps::Remove(Parameter& param)
+{
+    if (m_workers)
+    {
+        m_handOver.enqueue(&param);
+        return;
+    }
+
+    auto slot = param.m_rampSlot;
+    if (slot == Parameter::NoRamp)
+    {
+        return;
+    }
+
+    // Swap the last one into the gap
+    auto last = uint32_t(m_params.size() - 1);
+    if (slot != last)
+    {
+        m_params[slot] = m_params[last];
+        m_starts[slot] = m_starts[last];
+        m_deltas[slot] = m_deltas[last];
+        m_startTicks[slot] = m_startTicks[last];
+        m_tickScales[slot] = m_tickScales[last];
+        m_params[slot]->m_rampSlot = slot;
+    }
+    m_params.pop_back();
+    m_starts.pop_back();
+    m_deltas.pop_back();
+    m_startTicks.pop_back();
+    m_tickScales.pop_back();
+    m_values.pop_back();
+    param.m_rampSlot = Parameter::NoRamp;
+}
+
+void ParameterRamps::AddAutomation(Parameter& param)
+{
+    if (param.m_automationSlot == Parameter::NoRamp)
+    {
+        param.m_automationSlot = uint32_t(m_automated.size());
+        m_automated.push_back(&param);
+    }
+}
+
+void ParameterRamps::RemoveAutomation(Parameter& param)
+{
+    auto slot = param.m_automationSlot;
+    if (slot == Parameter::NoRamp)
+    {
+        return;
+    }
+
+    m_automated[slot] = m_automated.back();
+    m_automated[slot]->m_automationSlot = slot;
+    m_automated.pop_back();
+    param.m_automationSlot = Parameter::NoRamp;
+}
+
+void ParameterRamps::Delay(Parameter& param, uint32_t ticks)
+{
+    auto slot = param.m_rampSlot;
+    if (slot == Parameter::NoRamp)
+    {
+        return;
+    }
+    param.m_startTick += ticks;
+    m_startTicks[slot] = double(param.m_startTick);
+}
+
+void ParameterRamps::CatchUp(Parameter& param)
+{
+    // Only a lerp started this tick; one delayed to a sample offset already starts in the right place
+    if (param.m_startTick != m_tick || m_previousTick >= m_tick || param.m_spAutomation || param.m_value == param.m_endValue)
+    {
+        return;
+    }
+
+    param.m_startTick = m_previousTick;
+    param.Parameter::Update(uint64_t(m_tick));
+
+    // On a worker, the hand over picks up the new start tick
+    if (!m_workers && param.m_rampSlot != Parameter::NoRamp)
+    {
+        m_startTicks[param.m_rampSlot] = double(m_previousTick);
+    }
+}
+
+void ParameterRamps::Advance(int64_t tick)
+{
+    if (tick != m_tick)
+    {
+        m_previousTick = m_tick;
+        m_tick = tick;
+    }
+
+    // The lerp itself; no branches and no types, so this vectorizes
+    auto count = m_params.size();
+    auto now = double(tick);
+    for (size_t index = 0; index < count; index++)
+    {
+        auto frac = std::min(std::max((now - m_startTicks[index]) * m_tickScales[index], 0.0), 1.0);
+        m_values[index] = m_starts[index] + m_deltas[index] * frac;
+    }
+
+    // Write back; backwards, so finished ramps can be swapped out as we go
+    for (auto index = count; index-- > 0;)
+    {
+        auto& param = *m_params[index];
+        auto value = m_values[index];
+        auto end = m_starts[index] + m_deltas[index];
+        bool done = (now - m_startTicks[index]) * m_tickScales[index] >= 1.0;
+
+        param.m_currentTick = tick;
+        param.m_generation++;
+        switch (param.m_value.type)
+        {
+        case ParameterType::Float:
+            param.m_value.fVal = float(value);
+            done |= std::abs(float(value) - float(end)) <= std::numeric_limits<float>::epsilon();
+            break;
+        case ParameterType::Double:
+            param.m_value.dVal = value;
+            done |= std::abs(value - end) <= std::numeric_limits<float>::epsilon();
+            break;
+        case ParameterType::Int64:
+            param.m_value.iVal = int64_t(value);
+            break;
+        default:
+            done = true;
+            break;
+        }
+
+        if (done)
+        {
+            param.m_value = param.m_endValue;
+            Remove(param);
+        }
+    }
+
+    for (auto pParam : m_automated)
+    {
+        pParam->UpdateAutomation(uint64_t(tick));
+    }
+}
+
+} // namespace NodeGraph
@@ -2,6 +2,7 @@
 #include <stdexcept>
 
 #include "mutils/logger/logger.h"
+#include "nodegraph/model/graph.h"
 #include "nodegraph/model/node.h"
 #include "nodegraph/model/pin.h"
 
@@ -16,6 +17,7 @@ Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, float val, const Pa
     , m_direction(pinDir)
     , m_strName(pinName)
 {
+    SetRamps(&o.GetGraph().GetParameterRamps());
 }
 
 Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, double val, const ParameterAttributes& attribs)
@@ -24,6 +26,7 @@ Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, double val, const P
     , m_direction(pinDir)
     , m_strName(pinName)
 {
+    SetRamps(&o.GetGraph().GetParameterRamps());
 }
 
 Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, int64_t val, const ParameterAttributes& attribs)
@@ -32,6 +35,7 @@ Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, int64_t val, const
     , m_direction(pinDir)
     , m_strName(pinName)
 {
+    SetRamps(&o.GetGraph().GetParameterRamps());
 }
 
 Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, bool val, const ParameterAttributes& attribs)
@@ -40,6 +44,7 @@ Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, bool val, const Par
     , m_direction(pinDir)
     , m_strName(pinName)
 {
+    SetRamps(&o.GetGraph().GetParameterRamps());
 }
 
 Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, IFlowData* val, const ParameterAttributes& attribs)
@@ -48,6 +53,7 @@ Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, IFlowData* val, con
     , m_direction(pinDir)
     , m_strName(pinName)
 {
+    SetRamps(&o.GetGraph().GetParameterRamps());
 }
 
 Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, const std::string& str, const ParameterAttributes& attribs)
@@ -56,6 +62,7 @@ Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, const std::string&
     , m_direction(pinDir)
     , m_strName(pinName)
 {
+    SetRamps(&o.GetGraph().GetParameterRamps());
 }
 
 Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, const Parameter& param)
@@ -64,66 +71,67 @@ Pin::Pin(Node& o, PinDir pinDir, const std::string& pinName, const Parameter& pa
     , m_direction(pinDir)
     , m_strName(pinName)
 {
+    SetRamps(&o.GetGraph().GetParameterRamps());
 }
 // Note can be greater than 1 if the value is out of bounds
 double Pin::Normalized()
 {
-    auto min = m_attributes.min.To<double>();
-    auto max = m_attributes.max.To<double>();
+    auto min = m_spAttributes->min.To<double>();
+    auto max = m_spAttributes->max.To<double>();
 
     double ret;
-    if (m_attributes.taper == 1.0f)
+    if (m_spAttributes->taper == 1.0f)
     {
         ret = (GetValue<double>() - min) / (max - min);
     }
     else
     {
-        ret = std::pow(((GetValue<double>() - min) / (max - min)), (1.0 / m_attributes.taper));
+        ret = std::pow(((GetValue<double>() - min) / (max - min)), (1.0 / m_spAttributes->taper));
     }
     return std::clamp(ret, 0.0, 1.0);
 }
 
 double Pin::NormalizedStep() const
 {
-    auto min = m_attributes.min.To<double>();
-    auto max = m_attributes.max.To<double>();
-    return std::abs(m_attributes.step.To<double>() / (max - min));
+    auto min = m_spAttributes->min.To<double>();
+    auto max = m_spAttributes->max.To<double>();
+    return std::abs(m_spAttributes->step.To<double>() / (max - min));
 }
 
 double Pin::NormalizedOrigin() const
 {
-    auto min = m_attributes.min.To<double>();
-    auto max = m_attributes.max.To<double>();
-    auto origin = m_attributes.origin.To<double>();
+    auto min = m_spAttributes->min.To<double>();
+    auto max = m_spAttributes->max.To<double>();
+    auto origin = m_spAttributes->origin.To<double>();
     origin = std::max(origin, min);
 
     double ret;
-    if (m_attributes.taper == 1.0f)
+    if (m_spAttributes->taper == 1.0f)
     {
-        ret = ((m_attributes.origin.To<double>() - min) / (max - min));
+        ret = ((m_spAttributes->origin.To<double>() - min) / (max - min));
     }
     else
     {
         // Taper == 1 is linear
         auto p = (origin - min) / (max - min);
-        ret = (std::pow(p, (1.0 / (double)m_attributes.taper)));
+        ret = (std::pow(p, (1.0 / (double)m_spAttributes->taper)));
     }
     return std::clamp(ret, 0.0, 1.0);
 }
 
 void Pin::SetFromNormalized(double val)
 {
-    auto min = m_attributes.min.To<double>();
-    auto max = m_attributes.max.To<double>();
+    auto min = m_spAttributes->min.To<double>();
+    auto max = m_spAttributes->max.To<double>();
 
     val = std::clamp(val, 0.0, 1.0);
-    if (m_attributes.taper == 1.0f)
+    if (m_spAttributes->taper == 1.0f)
     {
         SetFrom<double>(min + (max - min) * val);
     }
 
     // algebraic taper
-    SetFrom<double>(min + (max - min) * std::pow(val, m_attributes.taper));
+    SetFrom<double>(min + (max - min) * std::pow(val, m_spAttributes->taper));
 }
 
 } // namespace NodeGraph
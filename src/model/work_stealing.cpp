@@ -0,0 +1,220 @@
+#include <cassert>
+
+#include "nodegraph/model/work_stealing.h"
+
+namespace NodeGraph
+{
+
+WorkStealingScheduler::WorkStealingScheduler(uint32_t numWorkers)
+{
+    // Queue 0 belongs to the thread calling Run
+    for (uint32_t worker = 0; worker <= numWorkers; worker++)
+    {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for (uint32_t worker = 1; worker <= numWorkers; worker++)
+    {
+        m_workers.emplace_back([this, worker]() { WorkerThread(worker); });
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        m_quit = true;
+    }
+    m_runStart.notify_all();
+
+    for (auto& thread : m_workers)
+    {
+        thread.join();
+    }
+}
+
+void WorkStealingScheduler::Prepare(const ExecutionPlan& plan)
+{
+    auto& steps = plan.GetSteps();
+
+    // Only grows; a plan rebuild with fewer nodes reuses the memory
+    if (m_pendingSize < steps.size())
+    {
+        m_pendingSize = steps.size();
+        m_pending = std::make_unique<std::atomic<uint32_t>[]>(m_pendingSize);
+        for (auto& spQueue : m_queues)
+        {
+            spQueue->steps.resize(m_pendingSize);
+        }
+    }
+
+    for (auto& spQueue : m_queues)
+    {
+        spQueue->top = 0;
+        spQueue->bottom = 0;
+    }
+
+    // Seed the queues round robin with the steps that have nothing to wait for
+    uint32_t nextQueue = 0;
+    for (uint32_t index = 0; index < uint32_t(steps.size()); index++)
+    {
+        m_pending[index].store(steps[index].numSources, std::memory_order_relaxed);
+        if (steps[index].numSources == 0)
+        {
+            auto& queue = *m_queues[nextQueue];
+            queue.steps[queue.bottom++] = index;
+            nextQueue = (nextQueue + 1) % uint32_t(m_queues.size());
+        }
+    }
+
+    m_remaining.store(uint32_t(steps.size()));
+    m_abort.store(false);
+    m_exception = nullptr;
+}
+
+void WorkStealingScheduler::Push(uint32_t worker, uint32_t step)
+{
+    auto& queue = *m_queues[worker];
+    std::lock_guard<MUtils::audio_spin_mutex> lock(queue.mutex);
+    assert(queue.bottom < queue.steps.size());
+    queue.steps[queue.bottom++] = step;
+}
+
+bool WorkStealingScheduler::Pop(uint32_t worker, uint32_t& step)
+{
+    auto& queue = *m_queues[worker];
+    std::lock_guard<MUtils::audio_spin_mutex> lock(queue.mutex);
+    if (queue.bottom == queue.top)
+    {
+        return false;
+    }
+
+    // Newest first; it is most likely to have its inputs still in cache
+    step = queue.steps[--queue.bottom];
+    return true;
+}
+
+bool WorkStealingScheduler::Steal(uint32_t worker, uint32_t& step)
+{
+    auto numQueues = uint32_t(m_queues.size());
+    for (uint32_t offset = 1; offset < numQueues; offset++)
+    {
+        auto& queue = *m_queues[(worker + offset) % numQueues];
+        std::lock_guard<MUtils::audio_spin_mutex> lock(queue.mutex);
+        if (queue.bottom != queue.top)
+        {
+            // Oldest first; it is the one the owner will get to last
+            step = queue.steps[queue.top++];
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingScheduler::Execute(uint32_t worker)
+{
+    auto& steps = m_pPlan->GetSteps();
+    while (m_remaining.load(std::memory_order_acquire) != 0 && !m_abort.load(std::memory_order_relaxed))
+    {
+        uint32_t index;
+        if (!Pop(worker, index) && !Steal(worker, index))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        try
+        {
+            (*m_pStep)(index);
+        }
+        catch (...)
+        {
+            // Dependents of this step can never run, so stop everyone
+            std::lock_guard<std::mutex> lock(m_exceptionMutex);
+            if (!m_exception)
+            {
+                m_exception = std::current_exception();
+            }
+            m_abort.store(true);
+            return;
+        }
+
+        // Release the steps waiting on this one; the last source to finish queues them
+        auto& step = steps[index];
+        auto pTargets = m_pPlan->GetTargets(step);
+        for (uint32_t target = 0; target < step.numTargets; target++)
+        {
+            if (m_pending[pTargets[target]].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                Push(worker, pTargets[target]);
+            }
+        }
+
+        m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void WorkStealingScheduler::WorkerThread(uint32_t worker)
+{
+    uint64_t lastRun = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_runMutex);
+            m_runStart.wait(lock, [&]() { return m_quit || m_runGeneration != lastRun; });
+            if (m_quit)
+            {
+                return;
+            }
+            lastRun = m_runGeneration;
+        }
+
+        Execute(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_busyWorkers--;
+        }
+        m_runDone.notify_one();
+    }
+}
+
+void WorkStealingScheduler::Run(const ExecutionPlan& plan, const std::function<void(uint32_t)>& fnStep)
+{
+    if (plan.GetSteps().empty())
+    {
+        return;
+    }
+
+    Prepare(plan);
+    m_pPlan = &plan;
+    m_pStep = &fnStep;
+
+    if (!m_workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_busyWorkers = uint32_t(m_workers.size());
+            m_runGeneration++;
+        }
+        m_runStart.notify_all();
+    }
+
+    Execute(0);
+
+    // The workers still reference the plan until they leave Execute
+    {
+        std::unique_lock<std::mutex> lock(m_runMutex);
+        m_runDone.wait(lock, [&]() { return m_busyWorkers == 0; });
+    }
+
+    m_pPlan = nullptr;
+    m_pStep = nullptr;
+
+    if (m_exception)
+    {
+        std::rethrow_exception(m_exception);
+    }
+}
+
+} // namespace NodeGraph
@@ -468,7 +468,7 @@ bool GraphView::DrawKnob(ViewNode& viewNode, Pin& param, NRectf rect, bool miniK
 
                     if (fNew != startValue)
                     {
-                        param.SetFromNormalized(fNew);
+                        m_pGraph->QueueParameterChangeNormalized(param, fNew);
                     }
                 }
             }
@@ -745,7 +745,7 @@ SliderData GraphView::DrawSlider(ViewNode& viewNode, Pin& param, NRectf region)
 
             auto fQuant = std::floor(fNewVal / fStep) * fStep;
 
-            param.SetFromNormalized(fQuant);
+            m_pGraph->QueueParameterChangeNormalized(param, fQuant);
         }
     }
 
@@ -869,7 +869,7 @@ void GraphView::DrawButton(ViewNode& viewNode, Pin& param, NRectf region)
                     currentButton |= ((int64_t)1 << i);
                 }
             }
-            param.SetFrom<int64_t>(currentButton);
+            m_pGraph->QueueParameterChange(param, ParameterValue(currentButton));
         }
 
         auto buttonColor = theme.Get(color_controlFillColor);